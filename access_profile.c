@@ -0,0 +1,187 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Profiles of the files each demo reads as it starts up */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+
+#include "access_profile.h"
+
+#define RECORD_SECONDS  30
+
+extern char **environ;
+
+/* The variables we set for the recorder, which come first in the
+   environment so they can be freed again
+ */
+#define NUM_RECORD_VARS 4
+
+void access_profile_path(const char *demo, char *path, int maxlen)
+{
+    snprintf(path, maxlen, "%s/.loki/loki_demos/%s/access.profile",
+             getenv("HOME"), demo);
+}
+
+static char *make_var(const char *name, const char *value)
+{
+    char *var;
+
+    var = (char *)malloc(strlen(name)+1+strlen(value)+1);
+    if ( var ) {
+        sprintf(var, "%s=%s", name, value);
+    }
+    return(var);
+}
+
+/* Find the recorder libraries in the install directory.
+   Both builds have the same name, so LD_PRELOAD names it without a path,
+   and ld.so looks for it in LD_LIBRARY_PATH.  While searching, ld.so
+   quietly skips libraries of the wrong ELF class, so a 32-bit game run
+   from a 64-bit shell script gets the 32-bit recorder, and the script
+   gets the 64-bit one.
+ */
+static int get_preload(char *preload, int maxlen, char *libpath, int pathlen)
+{
+    const char *dirs[] = { ACCESS_PROFILE_LIB32, ACCESS_PROFILE_LIB64 };
+    char cwd[PATH_MAX];
+    char shim[PATH_MAX];
+    int i, len;
+
+    if ( ! getcwd(cwd, sizeof(cwd)) ) {
+        return(-1);
+    }
+    len = 0;
+    libpath[0] = '\0';
+    for ( i=0; i<(sizeof dirs)/(sizeof dirs[0]); ++i ) {
+        snprintf(shim, sizeof(shim), "%s/%s", dirs[i], ACCESS_PROFILE_SHIM);
+        if ( access(shim, R_OK) == 0 ) {
+            len += snprintf(libpath+len, pathlen-len, "%s%s/%s",
+                            len ? ":" : "", cwd, dirs[i]);
+        }
+    }
+    if ( ! len ) {
+        return(-1);
+    }
+    if ( getenv("LD_LIBRARY_PATH") ) {
+        snprintf(libpath+len, pathlen-len, ":%s", getenv("LD_LIBRARY_PATH"));
+    }
+    len = snprintf(preload, maxlen, "%s", ACCESS_PROFILE_SHIM);
+    if ( getenv("LD_PRELOAD") ) {
+        snprintf(preload+len, maxlen-len, " %s", getenv("LD_PRELOAD"));
+    }
+    return(0);
+}
+
+char **access_profile_record(const char *demo)
+{
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    char preload[PATH_MAX];
+    char libpath[PATH_MAX*3];
+    char until[32];
+    struct stat sb;
+    char **env;
+    int i, n, fd;
+
+    access_profile_path(demo, path, sizeof(path));
+    if ( (stat(path, &sb) == 0) || (get_preload(preload, sizeof(preload), libpath, sizeof(libpath)) < 0) ) {
+        return(NULL);
+    }
+
+    /* Start with an empty log, the recorder only appends to it */
+    sprintf(temp, "%s/.loki", getenv("HOME"));
+    mkdir(temp, 0700);
+    strcat(temp, "/loki_demos");
+    mkdir(temp, 0700);
+    snprintf(temp, sizeof(temp), "%s/.loki/loki_demos/%s", getenv("HOME"), demo);
+    mkdir(temp, 0700);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    fd = open(temp, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+    if ( fd < 0 ) {
+        return(NULL);
+    }
+    close(fd);
+
+    /* Copy the environment, replacing the variables for the recorder */
+    for ( n=0; environ[n]; ++n ) {
+        continue;
+    }
+    env = (char **)malloc((NUM_RECORD_VARS+n+1)*(sizeof *env));
+    if ( ! env ) {
+        unlink(temp);
+        return(NULL);
+    }
+    sprintf(until, "%ld", (long)time(NULL) + RECORD_SECONDS);
+    env[0] = make_var("LD_PRELOAD", preload);
+    env[1] = make_var("LOKI_ACCESS_PROFILE", temp);
+    env[2] = make_var("LOKI_ACCESS_PROFILE_UNTIL", until);
+    env[3] = make_var("LD_LIBRARY_PATH", libpath);
+    if ( ! env[0] || ! env[1] || ! env[2] || ! env[3] ) {
+        for ( i=0; i<NUM_RECORD_VARS; ++i ) {
+            free(env[i]);
+        }
+        free(env);
+        unlink(temp);
+        return(NULL);
+    }
+    n = NUM_RECORD_VARS;
+    for ( i=0; environ[i]; ++i ) {
+        if ( (strncmp(environ[i], "LD_PRELOAD=", 11) != 0) &&
+             (strncmp(environ[i], "LD_LIBRARY_PATH=", 16) != 0) &&
+             (strncmp(environ[i], "LOKI_ACCESS_PROFILE", 19) != 0) ) {
+            env[n++] = environ[i];
+        }
+    }
+    env[n] = NULL;
+    return(env);
+}
+
+void access_profile_done(const char *demo, char **env)
+{
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    struct stat sb;
+    int i;
+
+    if ( ! env ) {
+        return;
+    }
+    for ( i=0; i<NUM_RECORD_VARS; ++i ) {
+        free(env[i]);
+    }
+    free(env);
+
+    /* Keep the profile if the demo got far enough to read anything */
+    access_profile_path(demo, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    if ( (stat(temp, &sb) == 0) && (sb.st_size > 0) ) {
+        rename(temp, path);
+    } else {
+        unlink(temp);
+    }
+}
@@ -0,0 +1,52 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Profiles of the files each demo reads as it starts up
+
+   When loki_demos is run with --record-profiles, the first launch of a
+   demo preloads the recorder in access_profile/ into it, which logs what
+   it reads into ~/.loki/loki_demos/<demo>/access.profile.  After that the
+   profile is replayed as read ahead whenever the demo is about to be
+   launched.
+
+   The 32-bit and 64-bit recorders are installed with the same name in
+   lib/ and lib64/ of the install directory, so each program the demo runs
+   loads the one that matches it, as long as its launch script adds to
+   LD_LIBRARY_PATH rather than replacing it.
+ */
+
+#define ACCESS_PROFILE_SHIM     "loki_access_profile.so"
+#define ACCESS_PROFILE_LIB32    "lib"
+#define ACCESS_PROFILE_LIB64    "lib64"
+
+/* Get the path to the access profile for a demo */
+extern void access_profile_path(const char *demo, char *path, int maxlen);
+
+/* Get ready to record the access profile for a demo, if it doesn't have
+   one yet and the recorder is installed.
+   This returns the environment to launch the demo with, or NULL if there
+   is nothing to record.
+ */
+extern char **access_profile_record(const char *demo);
+
+/* Put the recorded profile in place after the demo exits, and free the
+   environment returned by access_profile_record()
+ */
+extern void access_profile_done(const char *demo, char **env);
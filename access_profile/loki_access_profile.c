@@ -0,0 +1,384 @@
+/* Records which parts of which files a demo reads as it starts up, so that
+   loki_demos can read them ahead of time the next time it is launched.
+
+   loki_demos preloads this with LOKI_ACCESS_PROFILE set to the file to log
+   to, and LOKI_ACCESS_PROFILE_UNTIL set to the time to stop recording.
+   Each line of the log is a file name, an offset and a length, separated
+   by tabs, in roughly the order the demo read them.
+ */
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+
+#define MAX_FDS         1024
+#define RECORD_SECONDS  30
+#define MAX_RANGE       (1024*1024)
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_open64)(const char *, int, ...);
+static int (*real_openat)(int, const char *, int, ...);
+static FILE *(*real_fopen)(const char *, const char *);
+static FILE *(*real_fopen64)(const char *, const char *);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_pread)(int, void *, size_t, off_t);
+static ssize_t (*real_pread64)(int, void *, size_t, off64_t);
+static void *(*real_mmap)(void *, size_t, int, int, int, off_t);
+static void *(*real_mmap64)(void *, size_t, int, int, int, off64_t);
+static int (*real_close)(int);
+
+/* The range of each open file that is being read through */
+static struct {
+    char *path;
+    long long start, end;
+} files[MAX_FDS];
+static int log_fd = -1;
+static time_t stop_time;
+static volatile int locked;
+
+static void lock(void)
+{
+    while ( __sync_lock_test_and_set(&locked, 1) ) {
+        continue;
+    }
+}
+
+static void unlock(void)
+{
+    __sync_lock_release(&locked);
+}
+
+static void get_hooks(void)
+{
+    *(void **) (&real_open) = dlsym(RTLD_NEXT, "open");
+    *(void **) (&real_open64) = dlsym(RTLD_NEXT, "open64");
+    *(void **) (&real_openat) = dlsym(RTLD_NEXT, "openat");
+    *(void **) (&real_fopen) = dlsym(RTLD_NEXT, "fopen");
+    *(void **) (&real_fopen64) = dlsym(RTLD_NEXT, "fopen64");
+    *(void **) (&real_read) = dlsym(RTLD_NEXT, "read");
+    *(void **) (&real_pread) = dlsym(RTLD_NEXT, "pread");
+    *(void **) (&real_pread64) = dlsym(RTLD_NEXT, "pread64");
+    *(void **) (&real_mmap) = dlsym(RTLD_NEXT, "mmap");
+    *(void **) (&real_mmap64) = dlsym(RTLD_NEXT, "mmap64");
+    *(void **) (&real_close) = dlsym(RTLD_NEXT, "close");
+}
+
+void _init(void) {
+    char *file, *until;
+
+    get_hooks();
+    file = getenv("LOKI_ACCESS_PROFILE");
+    if ( file ) {
+        log_fd = real_open(file, O_WRONLY|O_APPEND|O_CLOEXEC);
+    }
+    until = getenv("LOKI_ACCESS_PROFILE_UNTIL");
+    if ( until ) {
+        stop_time = atol(until);
+    } else {
+        stop_time = time(NULL) + RECORD_SECONDS;
+    }
+}
+
+/* Write out the range read from a file, with the lock held */
+static void flush_range(int fd)
+{
+    char line[PATH_MAX+64];
+    int len;
+
+    if ( files[fd].end > files[fd].start ) {
+        /* A single write, so processes sharing the log don't mix lines */
+        len = snprintf(line, sizeof(line), "%s\t%lld\t%lld\n",
+                       files[fd].path, files[fd].start,
+                       files[fd].end - files[fd].start);
+        if ( (len > 0) && (len < sizeof(line)) ) {
+            if ( write(log_fd, line, len) < 0 ) {
+                /* Nothing we can do about it */
+            }
+        }
+    }
+    files[fd].start = files[fd].end;
+}
+
+/* Stop recording once the demo has started up, with the lock held */
+static int recording(void)
+{
+    int fd;
+
+    if ( log_fd < 0 ) {
+        return(0);
+    }
+    if ( time(NULL) >= stop_time ) {
+        for ( fd=0; fd<MAX_FDS; ++fd ) {
+            if ( files[fd].path ) {
+                flush_range(fd);
+                free(files[fd].path);
+                files[fd].path = NULL;
+            }
+        }
+        real_close(log_fd);
+        log_fd = -1;
+        return(0);
+    }
+    return(1);
+}
+
+static void forget_file(int fd)
+{
+    if ( (fd >= 0) && (fd < MAX_FDS) && files[fd].path ) {
+        lock();
+        if ( log_fd >= 0 ) {
+            flush_range(fd);
+        }
+        free(files[fd].path);
+        files[fd].path = NULL;
+        unlock();
+    }
+}
+
+/* Start tracking a newly opened file, by its real name */
+static void add_file(int fd)
+{
+    char link[64];
+    char path[PATH_MAX];
+    struct stat sb;
+    ssize_t len;
+
+    if ( (fd < 0) || (fd >= MAX_FDS) || (fd == log_fd) ) {
+        return;
+    }
+    forget_file(fd);
+    if ( (fstat(fd, &sb) < 0) || ! S_ISREG(sb.st_mode) ) {
+        return;
+    }
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    len = readlink(link, path, sizeof(path)-1);
+    if ( len <= 0 ) {
+        return;
+    }
+    path[len] = '\0';
+    if ( (strncmp(path, "/proc/", 6) == 0) ||
+         (strncmp(path, "/sys/", 5) == 0) ||
+         (strncmp(path, "/dev/", 5) == 0) ) {
+        return;
+    }
+
+    lock();
+    if ( recording() ) {
+        files[fd].path = strdup(path);
+        files[fd].start = 0;
+        files[fd].end = 0;
+    }
+    unlock();
+}
+
+static void add_range(int fd, long long offset, long long len)
+{
+    if ( (fd < 0) || (fd >= MAX_FDS) || (len <= 0) ) {
+        return;
+    }
+    lock();
+    if ( files[fd].path && recording() ) {
+        /* Reads that follow on from the last one are merged */
+        if ( (offset != files[fd].end) ||
+             ((files[fd].end - files[fd].start) >= MAX_RANGE) ) {
+            flush_range(fd);
+            files[fd].start = offset;
+        }
+        files[fd].end = offset + len;
+    }
+    unlock();
+}
+
+static long long current_offset(int fd)
+{
+    if ( (fd < 0) || (fd >= MAX_FDS) || ! files[fd].path ) {
+        return(-1);
+    }
+    return(lseek(fd, 0, SEEK_CUR));
+}
+
+int open(const char *path, int flags, ...)
+{
+    va_list ap;
+    mode_t mode;
+    int fd;
+
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+    if ( ! real_open ) {
+        get_hooks();
+    }
+    fd = real_open(path, flags, mode);
+    if ( (flags & O_ACCMODE) == O_RDONLY ) {
+        add_file(fd);
+    }
+    return fd;
+}
+
+int open64(const char *path, int flags, ...)
+{
+    va_list ap;
+    mode_t mode;
+    int fd;
+
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+    if ( ! real_open64 ) {
+        get_hooks();
+    }
+    fd = real_open64(path, flags, mode);
+    if ( (flags & O_ACCMODE) == O_RDONLY ) {
+        add_file(fd);
+    }
+    return fd;
+}
+
+int openat(int dirfd, const char *path, int flags, ...)
+{
+    va_list ap;
+    mode_t mode;
+    int fd;
+
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+    if ( ! real_openat ) {
+        get_hooks();
+    }
+    fd = real_openat(dirfd, path, flags, mode);
+    if ( (flags & O_ACCMODE) == O_RDONLY ) {
+        add_file(fd);
+    }
+    return fd;
+}
+
+/* Reads through stdio can't be seen, so assume the whole file is used */
+static void add_stream(FILE *fp, const char *mode)
+{
+    struct stat sb;
+    int fd;
+
+    if ( fp && (strcmp(mode, "r") == 0 || strcmp(mode, "rb") == 0) ) {
+        fd = fileno(fp);
+        add_file(fd);
+        if ( fstat(fd, &sb) == 0 ) {
+            add_range(fd, 0, sb.st_size);
+        }
+    }
+}
+
+FILE *fopen(const char *path, const char *mode)
+{
+    FILE *fp;
+
+    if ( ! real_fopen ) {
+        get_hooks();
+    }
+    fp = real_fopen(path, mode);
+    add_stream(fp, mode);
+    return fp;
+}
+
+FILE *fopen64(const char *path, const char *mode)
+{
+    FILE *fp;
+
+    if ( ! real_fopen64 ) {
+        get_hooks();
+    }
+    fp = real_fopen64(path, mode);
+    add_stream(fp, mode);
+    return fp;
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+    long long offset;
+    ssize_t result;
+
+    if ( ! real_read ) {
+        get_hooks();
+    }
+    offset = current_offset(fd);
+    result = real_read(fd, buf, count);
+    if ( (offset >= 0) && (result > 0) ) {
+        add_range(fd, offset, result);
+    }
+    return result;
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+{
+    ssize_t result;
+
+    if ( ! real_pread ) {
+        get_hooks();
+    }
+    result = real_pread(fd, buf, count, offset);
+    if ( result > 0 ) {
+        add_range(fd, offset, result);
+    }
+    return result;
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off64_t offset)
+{
+    ssize_t result;
+
+    if ( ! real_pread64 ) {
+        get_hooks();
+    }
+    result = real_pread64(fd, buf, count, offset);
+    if ( result > 0 ) {
+        add_range(fd, offset, result);
+    }
+    return result;
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+    void *result;
+
+    if ( ! real_mmap ) {
+        get_hooks();
+    }
+    result = real_mmap(addr, length, prot, flags, fd, offset);
+    if ( (result != MAP_FAILED) && ! (flags & MAP_ANONYMOUS) ) {
+        add_range(fd, offset, length);
+    }
+    return result;
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off64_t offset)
+{
+    void *result;
+
+    if ( ! real_mmap64 ) {
+        get_hooks();
+    }
+    result = real_mmap64(addr, length, prot, flags, fd, offset);
+    if ( (result != MAP_FAILED) && ! (flags & MAP_ANONYMOUS) ) {
+        add_range(fd, offset, length);
+    }
+    return result;
+}
+
+int close(int fd)
+{
+    if ( ! real_close ) {
+        get_hooks();
+    }
+    forget_file(fd);
+    return real_close(fd);
+}
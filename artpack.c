@@ -0,0 +1,164 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Reader for the prepacked artwork archive */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "artpack.h"
+
+static Uint8 *pack;
+static size_t pack_size;
+static const struct artpack_header *header;
+static const struct artpack_entry *entries;
+static const char *strings;
+
+static int check_entry(const struct artpack_entry *entry)
+{
+    if ( entry->path >= header->strings_size ) {
+        return(-1);
+    }
+    if ( ! entry->offset ) {
+        return(0);
+    }
+    if ( (SDL_BYTESPERPIXEL(entry->format) == 0) ||
+         (entry->pitch < (Uint64)entry->w * SDL_BYTESPERPIXEL(entry->format)) ||
+         (entry->offset > pack_size) ||
+         ((Uint64)entry->pitch * entry->h > pack_size - entry->offset) ) {
+        return(-1);
+    }
+    return(0);
+}
+
+int artpack_open(const char *file, SDL_PixelFormat format)
+{
+    struct stat sb;
+    Uint32 i;
+    int fd;
+    void *mem;
+    Uint64 table_end;
+
+    if ( pack ) {
+        return(0);
+    }
+
+    fd = open(file, O_RDONLY);
+    if ( fd < 0 ) {
+        return(-1);
+    }
+    if ( (fstat(fd, &sb) < 0) || (sb.st_size < sizeof(*header)) ) {
+        close(fd);
+        return(-1);
+    }
+    /* The mapping is private and writable so that surfaces can be locked */
+    mem = mmap(NULL, sb.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( mem == MAP_FAILED ) {
+        return(-1);
+    }
+    pack = (Uint8 *)mem;
+    pack_size = sb.st_size;
+
+    /* Make sure the archive is sane and usable with this window */
+    header = (const struct artpack_header *)pack;
+    entries = (const struct artpack_entry *)(pack + sizeof(*header));
+    table_end = sizeof(*header) +
+                (Uint64)header->num_entries * sizeof(*entries);
+    if ( (memcmp(header->magic, ARTPACK_MAGIC, sizeof(ARTPACK_MAGIC)) != 0) ||
+         (header->version != ARTPACK_VERSION) ||
+         (table_end > pack_size) ||
+         (header->strings_offset < table_end) ||
+         (header->strings_offset + header->strings_size > pack_size) ||
+         (header->strings_size == 0) ||
+         (pack[header->strings_offset + header->strings_size - 1] != '\0') ) {
+        fprintf(stderr, "Warning: %s is corrupt, ignoring it\n", file);
+        artpack_close();
+        return(-1);
+    }
+    if ( header->format != format ) {
+        fprintf(stderr, "Warning: %s was built for %s, not %s\n", file,
+                SDL_GetPixelFormatName(header->format),
+                SDL_GetPixelFormatName(format));
+        artpack_close();
+        return(-1);
+    }
+    strings = (const char *)(pack + header->strings_offset);
+
+    /* Check every entry once, so loading never reads outside the archive */
+    for ( i=0; i<header->num_entries; ++i ) {
+        if ( check_entry(&entries[i]) < 0 ) {
+            fprintf(stderr, "Warning: %s is corrupt, ignoring it\n", file);
+            artpack_close();
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int compare_entry(const void *key, const void *elem)
+{
+    const struct artpack_entry *entry = (const struct artpack_entry *)elem;
+
+    return(strcmp((const char *)key, strings + entry->path));
+}
+
+SDL_Surface *artpack_load(const char *path, int *kind)
+{
+    const struct artpack_entry *entry;
+    struct stat sb;
+
+    if ( ! pack ) {
+        return(NULL);
+    }
+    entry = (const struct artpack_entry *)bsearch(path, entries,
+                        header->num_entries, sizeof(*entries), compare_entry);
+    if ( ! entry || ! entry->offset ) {
+        return(NULL);
+    }
+
+    /* If the source image has changed, the archive is stale */
+    if ( (stat(path, &sb) < 0) ||
+         (sb.st_mtime != entry->mtime) || (sb.st_size != entry->size) ) {
+        return(NULL);
+    }
+    *kind = entry->surface_class;
+    return(SDL_CreateSurfaceFrom(entry->w, entry->h,
+                                 (SDL_PixelFormat)entry->format,
+                                 pack + entry->offset, entry->pitch));
+}
+
+void artpack_close(void)
+{
+    if ( pack ) {
+        munmap(pack, pack_size);
+        pack = NULL;
+        pack_size = 0;
+        header = NULL;
+        entries = NULL;
+        strings = NULL;
+    }
+}
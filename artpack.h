@@ -0,0 +1,75 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* The prepacked artwork archive, built by pack_artwork
+
+   The archive is a header, followed by a table of entries sorted by path,
+   a table of NUL terminated path strings, and the pixel data for each
+   image, already decoded and converted to the pixel format of the window.
+   Everything is stored in native byte order, the archive is meant to be
+   built on the machine that uses it.
+ */
+
+#include <SDL3/SDL.h>
+
+#define ARTPACK_FILE    "artwork.pak"
+#define ARTPACK_MAGIC   "LOKIPAK"
+#define ARTPACK_VERSION 2
+#define ARTPACK_ALIGN   64
+
+struct artpack_header {
+    char   magic[8];
+    Uint32 version;
+    Uint32 format;          /* The window format the archive was built for */
+    Uint32 num_entries;
+    Uint32 strings_size;
+    Uint64 strings_offset;
+};
+
+struct artpack_entry {
+    Uint32 path;            /* Offset of the path in the string table */
+    Uint32 format;          /* The pixel format of this image */
+    Uint32 w, h;
+    Uint32 pitch;
+    Uint32 surface_class;   /* How the image is blitted, from surface_prep.h */
+    Sint64 mtime;           /* Modification time of the source image */
+    Uint64 size;            /* Size of the source image */
+    Uint64 offset;          /* Offset of the pixel data, 0 if not packed */
+};
+
+/* Map the artwork archive into memory.
+   The archive is only used if it was built for the given window format.
+   This function returns 0, or -1 if the archive is missing or unusable.
+ */
+extern int artpack_open(const char *file, SDL_PixelFormat format);
+
+/* Create a surface for the given image file, pointing directly at the
+   pixels in the archive, and set kind to its class from surface_prep.h.
+   This returns NULL if the image isn't in the archive, or if the source
+   image has changed since the archive was built, in which case the caller
+   should load the image itself.
+   This function may be called from any thread.
+ */
+extern SDL_Surface *artpack_load(const char *path, int *kind);
+
+/* Unmap the archive.
+   This must not be called while any surfaces from the archive still exist.
+ */
+extern void artpack_close(void);
@@ -0,0 +1,604 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* The catalog of installed demos */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+
+#include "catalog.h"
+
+#define CATALOG_MAGIC   "LOKI_CATALOG"
+#define CATALOG_VERSION 2
+#define ARENA_BLOCK     (64*1024)
+
+/* Memory for the catalog strings, freed all at once */
+struct arena_block {
+    struct arena_block *next;
+    size_t used, size;
+    char data[1];
+};
+
+/* A set of catalog entries, sorted by name */
+struct catalog {
+    struct catalog_entry *entries;
+    int num_entries, max_entries;
+    struct arena_block *arena;
+};
+
+static struct catalog catalog;
+static int catalog_indexed = 0;
+
+/* The files checked for each demo, relative to the demo directory */
+static struct {
+    unsigned int asset;
+    const char *file;
+} asset_list[] = {
+    { ASSET_TRAILER,        "trailer.mpg" },
+    { ASSET_ICON,           "launch/box_off.png" },
+    { ASSET_ICON_HILITE,    "launch/box_on.png" },
+    { ASSET_CAPTION,        "launch/caption.png" },
+    { ASSET_BOX,            "launch/box.png" },
+    { ASSET_TEXT,           "launch/text.png" },
+    { ASSET_EXTRA,          "launch/extra.png" },
+    { ASSET_LAUNCH,         "launch/launch.txt" },
+    { ASSET_PREFS,          "launch/prefs.txt" }
+};
+
+static void *arena_alloc(struct catalog *list, size_t size)
+{
+    struct arena_block *block;
+    void *mem;
+
+    size = (size + 7) & ~7;
+    block = list->arena;
+    if ( ! block || (block->used + size > block->size) ) {
+        size_t block_size = (size > ARENA_BLOCK) ? size : ARENA_BLOCK;
+
+        block = (struct arena_block *)malloc(sizeof(*block) + block_size);
+        if ( ! block ) {
+            return(NULL);
+        }
+        block->used = 0;
+        block->size = block_size;
+        /* Keep the partly used block in front if this is a big one */
+        if ( list->arena && (size > ARENA_BLOCK) ) {
+            block->next = list->arena->next;
+            list->arena->next = block;
+        } else {
+            block->next = list->arena;
+            list->arena = block;
+        }
+    }
+    mem = block->data + block->used;
+    block->used += size;
+    return(mem);
+}
+
+static char *arena_strdup(struct catalog *list, const char *str)
+{
+    char *copy;
+
+    if ( ! str || ! *str ) {
+        return(NULL);
+    }
+    copy = (char *)arena_alloc(list, strlen(str)+1);
+    if ( copy ) {
+        strcpy(copy, str);
+    }
+    return(copy);
+}
+
+static void free_catalog(struct catalog *list)
+{
+    struct arena_block *block;
+
+    while ( list->arena ) {
+        block = list->arena;
+        list->arena = block->next;
+        free(block);
+    }
+    free(list->entries);
+    memset(list, 0, sizeof(*list));
+}
+
+static struct catalog_entry *add_entry(struct catalog *list)
+{
+    struct catalog_entry *entry;
+
+    if ( list->num_entries == list->max_entries ) {
+        struct catalog_entry *more;
+        int max_entries = list->max_entries ? list->max_entries*2 : 64;
+
+        more = (struct catalog_entry *)realloc(list->entries,
+                                        max_entries*(sizeof *more));
+        if ( ! more ) {
+            return(NULL);
+        }
+        list->entries = more;
+        list->max_entries = max_entries;
+    }
+    entry = &list->entries[list->num_entries];
+    memset(entry, 0, sizeof(*entry));
+    entry->order = list->num_entries++;
+    return(entry);
+}
+
+/* Demos with names differing only in case end up in reverse directory
+   order, as they always have.
+ */
+static int compare_entries(const void *a, const void *b)
+{
+    const struct catalog_entry *A = (const struct catalog_entry *)a;
+    const struct catalog_entry *B = (const struct catalog_entry *)b;
+    int result;
+
+    result = strcasecmp(A->name, B->name);
+    if ( result == 0 ) {
+        result = B->order - A->order;
+    }
+    return(result);
+}
+
+static void sort_catalog(struct catalog *list)
+{
+    int i;
+
+    if ( list->num_entries > 1 ) {
+        qsort(list->entries, list->num_entries, sizeof(*list->entries),
+              compare_entries);
+    }
+    for ( i=0; i<list->num_entries; ++i ) {
+        list->entries[i].order = i;
+    }
+}
+
+static char *read_line(struct catalog *list, const char *file)
+{
+    FILE *fp;
+    char line[1024];
+    char *first_line;
+
+    first_line = NULL;
+    fp = fopen(file, "r");
+    if ( fp ) {
+        if ( fgets(line, sizeof(line), fp) ) {
+            line[strlen(line)-1] = '\0';
+            first_line = arena_strdup(list, line);
+        }
+        fclose(fp);
+    }
+    return(first_line);
+}
+
+/* Directories can change more than once a second, so use nanoseconds */
+static long long get_mtime(const char *path)
+{
+    struct stat sb;
+
+    if ( stat(path, &sb) < 0 ) {
+        return(0);
+    }
+    return((long long)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec);
+}
+
+/* Files can be rewritten in place, so check their size as well */
+static void get_stamp(const char *path, long long *mtime, long long *size)
+{
+    struct stat sb;
+
+    if ( stat(path, &sb) < 0 ) {
+        *mtime = 0;
+        *size = 0;
+        return;
+    }
+    *mtime = (long long)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec;
+    *size = sb.st_size;
+}
+
+/* Check that the text files of an indexed demo haven't changed */
+static int check_stamps(const struct catalog_entry *entry)
+{
+    char path[PATH_MAX];
+    long long mtime, size;
+
+    snprintf(path, sizeof(path), "demos/%s/launch/website.txt", entry->name);
+    get_stamp(path, &mtime, &size);
+    if ( (mtime != entry->website_mtime) || (size != entry->website_size) ) {
+        return(-1);
+    }
+    snprintf(path, sizeof(path), "demos/%s/launch/launch.txt", entry->name);
+    get_stamp(path, &mtime, &size);
+    if ( (mtime != entry->launch_txt_mtime) ||
+         (size != entry->launch_txt_size) ) {
+        return(-1);
+    }
+    return(0);
+}
+
+static void set_trailer(struct catalog *list, struct catalog_entry *entry)
+{
+    char path[PATH_MAX];
+
+    if ( entry->assets & ASSET_TRAILER ) {
+        snprintf(path, sizeof(path), "demos/%s/trailer.mpg", entry->name);
+        entry->trailer = arena_strdup(list, path);
+    }
+}
+
+#define PROBED_ASSETS   (ASSET_TRAILER|ASSET_ICON|ASSET_CAPTION)
+
+/* Look at the files of a single demo.
+   If thorough is set every asset is checked, otherwise the rest of the
+   artwork is assumed to be there and the image loader will find out if it
+   isn't.  The icon and caption are always checked, since the menu lays out
+   the demos long before it gets around to decoding their icons.
+ */
+static int probe_demo(struct catalog *list, const char *name, int thorough)
+{
+    struct catalog_entry *entry;
+    char path[PATH_MAX];
+    int i;
+
+    entry = add_entry(list);
+    if ( ! entry ) {
+        return(-1);
+    }
+    entry->name = arena_strdup(list, name);
+    if ( ! entry->name ) {
+        --list->num_entries;
+        return(-1);
+    }
+
+    for ( i=0; i<(sizeof asset_list)/(sizeof asset_list[0]); ++i ) {
+        if ( thorough || (asset_list[i].asset & PROBED_ASSETS) ) {
+            snprintf(path, sizeof(path), "demos/%s/%s",
+                     name, asset_list[i].file);
+            if ( access(path, R_OK) == 0 ) {
+                entry->assets |= asset_list[i].asset;
+            }
+        } else if ( strstr(asset_list[i].file, ".png") ) {
+            entry->assets |= asset_list[i].asset;
+        }
+    }
+    set_trailer(list, entry);
+
+    snprintf(path, sizeof(path), "demos/%s/launch/website.txt", name);
+    entry->website = read_line(list, path);
+    if ( thorough ) {
+        get_stamp(path, &entry->website_mtime, &entry->website_size);
+        snprintf(path, sizeof(path), "demos/%s/launch/launch.txt", name);
+        entry->launch = read_line(list, path);
+        get_stamp(path, &entry->launch_txt_mtime, &entry->launch_txt_size);
+        snprintf(path, sizeof(path), "demos/%s", name);
+        entry->dir_mtime = get_mtime(path);
+        snprintf(path, sizeof(path), "demos/%s/launch", name);
+        entry->launch_mtime = get_mtime(path);
+    }
+    return(0);
+}
+
+static void scan_demos(struct catalog *list, int thorough)
+{
+    DIR *dir;
+    struct dirent *dirent;
+
+    dir = opendir("demos");
+    if ( dir ) {
+        while ( (dirent=readdir(dir)) != NULL ) {
+            if ( dirent->d_name[0] == '.' ) {
+                continue;
+            }
+            if ( probe_demo(list, dirent->d_name, thorough) < 0 ) {
+                fprintf(stderr, "Out of memory\n");
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    sort_catalog(list);
+}
+
+/* Split off the next tab separated field, undoing the escapes */
+static char *next_field(char **line)
+{
+    char *field, *src, *dst;
+
+    field = *line;
+    if ( ! field ) {
+        return(NULL);
+    }
+    for ( src=dst=field; *src && (*src != '\t'); ++src ) {
+        if ( (*src == '\\') && src[1] ) {
+            ++src;
+            switch (*src) {
+                case 't':
+                    *dst++ = '\t';
+                    break;
+                case 'n':
+                    *dst++ = '\n';
+                    break;
+                default:
+                    *dst++ = *src;
+                    break;
+            }
+        } else {
+            *dst++ = *src;
+        }
+    }
+    *line = (*src == '\t') ? src+1 : NULL;
+    *dst = '\0';
+    return(field);
+}
+
+/* Read the index, returning 0 if it is current, or -1 otherwise.
+   The strings point straight into the copy of the index in the arena.
+ */
+static int read_index(struct catalog *list, const char *file)
+{
+    struct catalog_entry *entry;
+    struct stat sb;
+    char *data, *line, *next, *field;
+    char path[PATH_MAX];
+    long long mtime;
+    int fd, version;
+
+    fd = open(file, O_RDONLY);
+    if ( fd < 0 ) {
+        return(-1);
+    }
+    data = NULL;
+    if ( fstat(fd, &sb) == 0 ) {
+        data = (char *)arena_alloc(list, sb.st_size+1);
+    }
+    if ( ! data || (read(fd, data, sb.st_size) != sb.st_size) ) {
+        close(fd);
+        return(-1);
+    }
+    close(fd);
+    data[sb.st_size] = '\0';
+
+    /* Check the header against the demos directory */
+    next = strchr(data, '\n');
+    if ( ! next ||
+         (sscanf(data, CATALOG_MAGIC " %d %lld", &version, &mtime) != 2) ||
+         (version != CATALOG_VERSION) ||
+         (mtime != get_mtime("demos")) ) {
+        return(-1);
+    }
+
+    for ( line=next+1; *line; line=next ) {
+        next = strchr(line, '\n');
+        if ( next ) {
+            *next++ = '\0';
+        } else {
+            next = line+strlen(line);
+        }
+
+        entry = add_entry(list);
+        if ( ! entry ) {
+            return(-1);
+        }
+        entry->name = next_field(&line);
+        field = next_field(&line);
+        entry->dir_mtime = field ? strtoll(field, NULL, 10) : 0;
+        field = next_field(&line);
+        entry->launch_mtime = field ? strtoll(field, NULL, 10) : 0;
+        field = next_field(&line);
+        entry->website_mtime = field ? strtoll(field, NULL, 10) : 0;
+        field = next_field(&line);
+        entry->website_size = field ? strtoll(field, NULL, 10) : 0;
+        field = next_field(&line);
+        entry->launch_txt_mtime = field ? strtoll(field, NULL, 10) : 0;
+        field = next_field(&line);
+        entry->launch_txt_size = field ? strtoll(field, NULL, 10) : 0;
+        field = next_field(&line);
+        entry->assets = field ? (unsigned int)strtoul(field, NULL, 16) : 0;
+        entry->website = next_field(&line);
+        entry->launch = next_field(&line);
+        if ( ! entry->name || ! *entry->name ) {
+            return(-1);
+        }
+        if ( entry->website && ! *entry->website ) {
+            entry->website = NULL;
+        }
+        if ( entry->launch && ! *entry->launch ) {
+            entry->launch = NULL;
+        }
+        set_trailer(list, entry);
+
+        /* Make sure nothing in the demo has changed */
+        snprintf(path, sizeof(path), "demos/%s", entry->name);
+        if ( get_mtime(path) != entry->dir_mtime ) {
+            return(-1);
+        }
+        snprintf(path, sizeof(path), "demos/%s/launch", entry->name);
+        if ( get_mtime(path) != entry->launch_mtime ) {
+            return(-1);
+        }
+        if ( check_stamps(entry) < 0 ) {
+            return(-1);
+        }
+    }
+    /* The index was written in sorted order */
+    return(0);
+}
+
+int catalog_load(struct catalog_entry **entries)
+{
+    catalog_free();
+    if ( read_index(&catalog, CATALOG_FILE) == 0 ) {
+        catalog_indexed = 1;
+    } else {
+        free_catalog(&catalog);
+        scan_demos(&catalog, 0);
+    }
+    *entries = catalog.entries;
+    return(catalog.num_entries);
+}
+
+static int compare_name(const void *key, const void *elem)
+{
+    const struct catalog_entry *entry = (const struct catalog_entry *)elem;
+
+    return(strcasecmp((const char *)key, entry->name));
+}
+
+struct catalog_entry *catalog_find(const char *name)
+{
+    struct catalog_entry *entry, *first, *last;
+
+    entry = (struct catalog_entry *)bsearch(name, catalog.entries,
+                catalog.num_entries, sizeof(*catalog.entries), compare_name);
+    if ( ! entry ) {
+        return(NULL);
+    }
+
+    /* Prefer the demo with exactly the same name */
+    first = entry;
+    while ( (first > catalog.entries) &&
+            (strcasecmp(name, first[-1].name) == 0) ) {
+        --first;
+    }
+    last = catalog.entries + catalog.num_entries;
+    for ( entry=first; (entry < last) &&
+                       (strcasecmp(name, entry->name) == 0); ++entry ) {
+        if ( strcmp(name, entry->name) == 0 ) {
+            return(entry);
+        }
+    }
+    return(first);
+}
+
+void catalog_free(void)
+{
+    free_catalog(&catalog);
+    catalog_indexed = 0;
+}
+
+static void write_field(FILE *fp, const char *field)
+{
+    if ( field ) {
+        for ( ; *field; ++field ) {
+            switch (*field) {
+                case '\t':
+                    fputs("\\t", fp);
+                    break;
+                case '\n':
+                    fputs("\\n", fp);
+                    break;
+                case '\\':
+                    fputs("\\\\", fp);
+                    break;
+                default:
+                    fputc(*field, fp);
+                    break;
+            }
+        }
+    }
+}
+
+int catalog_write(const char *file)
+{
+    struct catalog list;
+    struct catalog_entry *entry;
+    char temp[PATH_MAX];
+    FILE *fp;
+    int i;
+
+    snprintf(temp, sizeof(temp), "%s.tmp", file);
+    fp = fopen(temp, "w");
+    if ( ! fp ) {
+        perror(temp);
+        return(-1);
+    }
+    fprintf(fp, CATALOG_MAGIC " %d %lld\n",
+            CATALOG_VERSION, get_mtime("demos"));
+    memset(&list, 0, sizeof(list));
+    scan_demos(&list, 1);
+    for ( i=0; i<list.num_entries; ++i ) {
+        entry = &list.entries[i];
+        write_field(fp, entry->name);
+        fprintf(fp, "\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%x\t",
+                entry->dir_mtime, entry->launch_mtime,
+                entry->website_mtime, entry->website_size,
+                entry->launch_txt_mtime, entry->launch_txt_size,
+                entry->assets);
+        write_field(fp, entry->website);
+        fputc('\t', fp);
+        write_field(fp, entry->launch);
+        fputc('\n', fp);
+    }
+    free_catalog(&list);
+    if ( ferror(fp) | fclose(fp) ) {
+        fprintf(stderr, "Couldn't write %s\n", temp);
+        unlink(temp);
+        return(-1);
+    }
+    if ( rename(temp, file) < 0 ) {
+        perror(file);
+        unlink(temp);
+        return(-1);
+    }
+    return(i);
+}
+
+int catalog_launch_command(const char *name, char *command, int maxlen)
+{
+    struct catalog_entry *entry;
+    char path[PATH_MAX];
+    FILE *fp;
+
+    /* The user's preferences come first */
+    snprintf(path, sizeof(path), "%s/.loki/loki_demos/%s/launch.txt",
+             getenv("HOME"), name);
+    fp = fopen(path, "r");
+    if ( ! fp ) {
+        /* The index already has the default command line */
+        entry = catalog_find(name);
+        if ( entry && catalog_indexed ) {
+            if ( ! entry->launch ) {
+                return(-1);
+            }
+            strncpy(command, entry->launch, maxlen-1);
+            command[maxlen-1] = '\0';
+            return(0);
+        }
+        snprintf(path, sizeof(path), "demos/%s/launch/launch.txt", name);
+        fp = fopen(path, "r");
+    }
+
+    /* Read the command line from the launch.txt file */
+    command[0] = '\0';
+    if ( fp ) {
+        if ( fgets(command, maxlen, fp) ) {
+            command[strlen(command)-1] = '\0';
+        }
+        fclose(fp);
+    }
+    return(command[0] ? 0 : -1);
+}
@@ -0,0 +1,84 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* The catalog of installed demos
+
+   The catalog is normally read from an index file written by pack_artwork,
+   so that starting up doesn't have to probe every file of every demo.
+   The index is only trusted while the modification times of the demos
+   directory, and of each demo and its launch directory, are unchanged,
+   and so are the times and sizes of each website.txt and launch.txt.
+   Otherwise the demos directory is scanned the old fashioned way.
+
+   The entries are kept in a single array sorted by name, and all of their
+   strings come from one arena, so the whole catalog is freed at once.
+ */
+
+#define CATALOG_FILE    "catalog.idx"
+
+/* The files a demo may provide */
+#define ASSET_TRAILER       0x0001      /* trailer.mpg */
+#define ASSET_ICON          0x0002      /* launch/box_off.png */
+#define ASSET_ICON_HILITE   0x0004      /* launch/box_on.png */
+#define ASSET_CAPTION       0x0008      /* launch/caption.png */
+#define ASSET_BOX           0x0010      /* launch/box.png */
+#define ASSET_TEXT          0x0020      /* launch/text.png */
+#define ASSET_EXTRA         0x0040      /* launch/extra.png */
+#define ASSET_LAUNCH        0x0080      /* launch/launch.txt */
+#define ASSET_PREFS         0x0100      /* launch/prefs.txt */
+
+struct catalog_entry {
+    char *name;
+    char *trailer;          /* The path to the trailer, or NULL */
+    char *website;          /* The first line of website.txt, or NULL */
+    char *launch;           /* The first line of launch.txt, or NULL */
+    unsigned int assets;
+    long long dir_mtime;    /* In nanoseconds */
+    long long launch_mtime;
+    /* Editing these in place doesn't touch the directory times */
+    long long website_mtime, website_size;
+    long long launch_txt_mtime, launch_txt_size;
+    int order;              /* The position of the entry in the catalog */
+};
+
+/* Load the catalog, from the index if it is current.
+   This returns the number of demos, and the array of entries, sorted
+   case insensitively by name.  The array is valid until catalog_free().
+ */
+extern int catalog_load(struct catalog_entry **entries);
+
+/* Find a demo in the loaded catalog, preferring an exact match over one
+   that differs in case.  This returns NULL if the demo isn't there.
+ */
+extern struct catalog_entry *catalog_find(const char *name);
+
+/* Free the loaded catalog */
+extern void catalog_free(void);
+
+/* Scan the demos directory and write a fresh index.
+   This returns the number of demos, or -1 if the index couldn't be written.
+ */
+extern int catalog_write(const char *file);
+
+/* Find the command line used to launch a demo, from the user's preferences
+   in ~/.loki/loki_demos/<demo>/launch.txt, or else the one from the demo.
+   This returns 0, or -1 if there is no launch command for the demo.
+ */
+extern int catalog_launch_command(const char *name, char *command, int maxlen);
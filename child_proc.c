@@ -0,0 +1,719 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Supervision of the processes started by the launcher */
+
+#define _GNU_SOURCE     /* For pipe2() and F_SETPIPE_SZ */
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <spawn.h>
+
+#include "child_proc.h"
+#include "ring_log.h"
+
+#define MAX_CHILDREN    16
+
+/* How much output a child can write before it has to wait for us */
+#define OUTPUT_PIPE_SIZE    (256*1024)
+
+/* The characters that mean a command line has to be run by the shell */
+#define SHELL_CHARS     "|&;<>()$`\\'*?[]~#{}\n"
+
+extern char **environ;
+
+struct child {
+    pid_t pid;              /* 0 if the slot is free */
+    int pidfd;              /* -1 if we rely on SIGCHLD */
+    int exited;
+    int status;
+    struct rusage usage;
+    int output;             /* The child's stdout and stderr, or -1 */
+    struct ring_log *log;
+};
+
+static struct child children[MAX_CHILDREN];
+static Uint32 exit_event;
+static SDL_Thread *watcher;
+static SDL_Mutex *lock;
+static SDL_Condition *child_exited;
+static int wake_pipe[2] = { -1, -1 };
+static int use_sigchld;
+static int quitting;
+
+/* Output taken from the logs, written out by the watcher without the lock */
+static struct ring_log_batch *unsaved, *unsaved_tail;
+
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return(syscall(SYS_pidfd_open, pid, 0));
+#else
+    errno = ENOSYS;
+    return(-1);
+#endif
+}
+
+static void wake_watcher(void)
+{
+    char c = 0;
+
+    if ( write(wake_pipe[1], &c, 1) < 0 ) {
+        /* The pipe is full, so the watcher is going to wake up anyway */
+    }
+}
+
+static void sigchld_handler(int sig)
+{
+    int saved_errno;
+
+    saved_errno = errno;
+    wake_watcher();
+    errno = saved_errno;
+}
+
+/* Without pidfds, the watcher is woken up by any child exiting */
+static void catch_sigchld(void)
+{
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigchld_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART|SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, NULL);
+    use_sigchld = 1;
+}
+
+static int find_child(pid_t pid)
+{
+    int i;
+
+    for ( i=0; i<MAX_CHILDREN; ++i ) {
+        if ( children[i].pid && (children[i].pid == pid) ) {
+            return(i);
+        }
+    }
+    return(-1);
+}
+
+/* Queue the output collected for a child, with the lock held */
+static void queue_output(struct child *child)
+{
+    struct ring_log_batch *batch;
+
+    batch = ring_log_take(child->log);
+    if ( batch ) {
+        if ( unsaved_tail ) {
+            unsaved_tail->next = batch;
+        } else {
+            unsaved = batch;
+        }
+        unsaved_tail = batch;
+    }
+}
+
+/* Write out the queued output, without the lock held */
+static void save_output(struct ring_log_batch *batch)
+{
+    struct ring_log_batch *next;
+
+    for ( ; batch; batch = next ) {
+        next = batch->next;
+        ring_log_save(batch);
+    }
+}
+
+static void close_output(struct child *child)
+{
+    if ( child->output >= 0 ) {
+        close(child->output);
+        child->output = -1;
+    }
+    if ( child->log ) {
+        queue_output(child);
+        ring_log_destroy(child->log);
+        child->log = NULL;
+    }
+}
+
+/* Move whatever a child has printed into its log, without blocking */
+static void drain_output(struct child *child)
+{
+    char buf[4096];
+    ssize_t len;
+    int reads;
+
+    /* Don't let a really chatty child keep us here forever */
+    for ( reads=0; reads<OUTPUT_PIPE_SIZE/sizeof(buf); ++reads ) {
+        len = read(child->output, buf, sizeof(buf));
+        if ( len > 0 ) {
+            ring_log_write(child->log, buf, len);
+            if ( ring_log_pending(child->log) >= RING_LOG_SIZE/2 ) {
+                queue_output(child);
+            }
+        } else if ( (len == 0) || ((errno != EAGAIN) && (errno != EINTR)) ) {
+            close_output(child);
+            return;
+        } else if ( errno == EAGAIN ) {
+            break;
+        }
+    }
+}
+
+/* Collect any watched children that have exited, with the lock held */
+static void reap_children(void)
+{
+    struct child *child;
+    SDL_Event event;
+    pid_t pid;
+    int i;
+
+    for ( i=0; i<MAX_CHILDREN; ++i ) {
+        child = &children[i];
+        if ( ! child->pid || child->exited ) {
+            continue;
+        }
+        pid = wait4(child->pid, &child->status, WNOHANG, &child->usage);
+        if ( (pid == 0) || ((pid < 0) && (errno == EINTR)) ) {
+            continue;
+        }
+        if ( pid < 0 ) {
+            /* Somebody else collected it, the exit status is lost */
+            child->status = -1;
+            memset(&child->usage, 0, sizeof(child->usage));
+        }
+        child->exited = 1;
+        /* Anything still running with the pipe open loses its output */
+        if ( child->output >= 0 ) {
+            drain_output(child);
+            close_output(child);
+        }
+        if ( child->pidfd >= 0 ) {
+            close(child->pidfd);
+            child->pidfd = -1;
+        }
+        SDL_BroadcastCondition(child_exited);
+        if ( exit_event ) {
+            SDL_zero(event);
+            event.type = exit_event;
+            event.user.code = child->pid;
+            SDL_PushEvent(&event);
+        }
+    }
+}
+
+static int child_watcher(void *unused)
+{
+    struct pollfd fds[2*MAX_CHILDREN+1];
+    struct ring_log_batch *batch;
+    char buf[64];
+    int i, n;
+
+    SDL_LockMutex(lock);
+    while ( ! quitting ) {
+        fds[0].fd = wake_pipe[0];
+        fds[0].events = POLLIN;
+        n = 1;
+        for ( i=0; i<MAX_CHILDREN; ++i ) {
+            if ( children[i].pid && ! children[i].exited &&
+                 (children[i].pidfd >= 0) ) {
+                fds[n].fd = children[i].pidfd;
+                fds[n].events = POLLIN;
+                ++n;
+            }
+            if ( children[i].pid && (children[i].output >= 0) ) {
+                fds[n].fd = children[i].output;
+                fds[n].events = POLLIN;
+                ++n;
+            }
+        }
+        SDL_UnlockMutex(lock);
+
+        /* Sleep until a child exits, prints something, or the list of
+           children changes
+         */
+        if ( poll(fds, n, -1) > 0 ) {
+            if ( fds[0].revents & POLLIN ) {
+                while ( read(wake_pipe[0], buf, sizeof(buf)) > 0 ) {
+                    continue;
+                }
+            }
+        }
+
+        SDL_LockMutex(lock);
+        for ( i=0; i<MAX_CHILDREN; ++i ) {
+            if ( children[i].pid && (children[i].output >= 0) ) {
+                drain_output(&children[i]);
+            }
+        }
+        reap_children();
+
+        /* A slow disk mustn't hold up anyone waiting for the lock */
+        batch = unsaved;
+        unsaved = unsaved_tail = NULL;
+        if ( batch ) {
+            SDL_UnlockMutex(lock);
+            save_output(batch);
+            SDL_LockMutex(lock);
+        }
+    }
+    SDL_UnlockMutex(lock);
+    return(0);
+}
+
+/* Parse a command line buffer into arguments.
+   These are the same quoting rules as parse_line() in demo_config.
+ */
+static int parse_line(char *line, char **argv)
+{
+    char *bufp;
+    int argc;
+
+    argc = 0;
+    for ( bufp = line; *bufp; ) {
+        /* Skip leading whitespace */
+        while ( isspace((unsigned char)*bufp) ) {
+            ++bufp;
+        }
+        /* Skip over argument */
+        if ( *bufp == '"' ) {
+            ++bufp;
+            if ( *bufp ) {
+                if ( argv ) {
+                    argv[argc] = bufp;
+                }
+                ++argc;
+            }
+            /* Skip over word */
+            while ( *bufp && (*bufp != '"') ) {
+                ++bufp;
+            }
+        } else {
+            if ( *bufp ) {
+                if ( argv ) {
+                    argv[argc] = bufp;
+                }
+                ++argc;
+            }
+            /* Skip over word */
+            while ( *bufp && ! isspace((unsigned char)*bufp) ) {
+                ++bufp;
+            }
+        }
+        if ( *bufp ) {
+            if ( argv ) {
+                *bufp = '\0';
+            }
+            ++bufp;
+        }
+    }
+    if ( argv ) {
+        argv[argc] = NULL;
+    }
+    return(argc);
+}
+
+/* See if a command line uses anything parse_line() wouldn't split the way
+   the shell does: redirections, variables, globs, quotes inside of words,
+   or environment assignments in front of the command.
+ */
+static int needs_shell(const char *line)
+{
+    const char *bufp;
+    int word_start, first_word, quoted;
+
+    word_start = 1;
+    first_word = 1;
+    quoted = 0;
+    for ( bufp = line; *bufp; ++bufp ) {
+        if ( quoted ) {
+            if ( *bufp == '"' ) {
+                quoted = 0;
+                /* The shell would glue anything after the quote on */
+                if ( bufp[1] && ! isspace((unsigned char)bufp[1]) ) {
+                    return(1);
+                }
+            } else if ( strchr("$`\\", *bufp) ) {
+                return(1);
+            }
+        } else if ( isspace((unsigned char)*bufp) ) {
+            if ( ! word_start ) {
+                first_word = 0;
+            }
+            word_start = 1;
+        } else {
+            if ( *bufp == '"' ) {
+                if ( ! word_start ) {
+                    return(1);
+                }
+                quoted = 1;
+            } else if ( strchr(SHELL_CHARS, *bufp) ||
+                        ((*bufp == '=') && first_word) ) {
+                return(1);
+            }
+            word_start = 0;
+        }
+    }
+    return(quoted);
+}
+
+pid_t child_proc_spawn(const char *command, char **env, int *output)
+{
+    posix_spawn_file_actions_t actions, *file_actions;
+    int output_pipe[2];
+    char *shell_argv[4];
+    char *line, **argv;
+    int argc, error;
+    pid_t pid;
+
+    if ( ! env ) {
+        env = environ;
+    }
+
+    /* Only the watcher thread can keep up with the output */
+    file_actions = NULL;
+    if ( output ) {
+        *output = -1;
+        if ( watcher && (pipe2(output_pipe, O_CLOEXEC) == 0) ) {
+#ifdef F_SETPIPE_SZ
+            fcntl(output_pipe[1], F_SETPIPE_SZ, OUTPUT_PIPE_SIZE);
+#endif
+            fcntl(output_pipe[0], F_SETFL, O_NONBLOCK);
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_adddup2(&actions, output_pipe[1], 1);
+            posix_spawn_file_actions_adddup2(&actions, output_pipe[1], 2);
+            file_actions = &actions;
+        }
+    }
+
+    line = NULL;
+    argv = NULL;
+    if ( needs_shell(command) ) {
+        shell_argv[0] = "sh";
+        shell_argv[1] = "-c";
+        shell_argv[2] = (char *)command;
+        shell_argv[3] = NULL;
+        error = posix_spawn(&pid, "/bin/sh", file_actions, NULL,
+                            shell_argv, env);
+    } else {
+        line = strdup(command);
+        argc = line ? parse_line(line, NULL) : 0;
+        argv = (char **)malloc((argc+1)*(sizeof *argv));
+        if ( (argc == 0) || ! argv ) {
+            error = EINVAL;
+        } else {
+            parse_line(line, argv);
+            error = posix_spawnp(&pid, argv[0], file_actions, NULL, argv, env);
+        }
+    }
+    if ( error ) {
+        fprintf(stderr, "Couldn't run %s: %s\n", command, strerror(error));
+        pid = -1;
+    }
+    if ( file_actions ) {
+        posix_spawn_file_actions_destroy(file_actions);
+        close(output_pipe[1]);
+        if ( pid > 0 ) {
+            *output = output_pipe[0];
+        } else {
+            close(output_pipe[0]);
+        }
+    }
+    free(argv);
+    free(line);
+    return(pid);
+}
+
+/* See if a word is an environment assignment, like the shell would */
+static int is_assignment(const char *word)
+{
+    const char *bufp;
+
+    for ( bufp = word; isalnum((unsigned char)*bufp) || (*bufp == '_'); ++bufp ) {
+        continue;
+    }
+    return((bufp != word) && (*bufp == '='));
+}
+
+int child_proc_program(const char *command, char *program, int maxlen)
+{
+    char *line, **argv;
+    char *path, *next;
+    int argc, i, result;
+
+    line = strdup(command);
+    argc = line ? parse_line(line, NULL) : 0;
+    argv = (char **)malloc((argc+1)*(sizeof *argv));
+    if ( ! argc || ! argv ) {
+        free(argv);
+        free(line);
+        return(-1);
+    }
+    parse_line(line, argv);
+
+    /* Skip any environment settings in front of the program */
+    for ( i=0; argv[i] && is_assignment(argv[i]); ++i ) {
+        continue;
+    }
+    result = -1;
+    if ( ! argv[i] ) {
+        /* Nothing but assignments */
+    } else if ( strchr(argv[i], '/') ) {
+        snprintf(program, maxlen, "%s", argv[i]);
+        result = 0;
+    } else {
+        /* Look for it in the PATH, the way posix_spawnp() would */
+        path = getenv("PATH");
+        while ( path && *path ) {
+            next = strchr(path, ':');
+            if ( ! next ) {
+                next = path+strlen(path);
+            }
+            snprintf(program, maxlen, "%.*s/%s",
+                     (int)(next-path), path, argv[i]);
+            if ( (next > path) && (access(program, X_OK) == 0) ) {
+                result = 0;
+                break;
+            }
+            path = *next ? next+1 : next;
+        }
+    }
+    free(argv);
+    free(line);
+    return(result);
+}
+
+int child_proc_init(Uint32 event_type)
+{
+    int i;
+
+    exit_event = event_type;
+    if ( pipe(wake_pipe) < 0 ) {
+        perror("Couldn't create child watcher pipe");
+        wake_pipe[0] = wake_pipe[1] = -1;
+        return(-1);
+    }
+    for ( i=0; i<2; ++i ) {
+        fcntl(wake_pipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(wake_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    lock = SDL_CreateMutex();
+    child_exited = SDL_CreateCondition();
+    if ( ! lock || ! child_exited ) {
+        fprintf(stderr, "Couldn't create child watcher: %s\n", SDL_GetError());
+        child_proc_quit();
+        return(-1);
+    }
+    quitting = 0;
+    watcher = SDL_CreateThread(child_watcher, "child_watcher", NULL);
+    if ( ! watcher ) {
+        fprintf(stderr, "Couldn't create child watcher thread: %s\n",
+                SDL_GetError());
+        child_proc_quit();
+        return(-1);
+    }
+    return(0);
+}
+
+int child_proc_watch(pid_t pid, int output, const char *log)
+{
+    struct child *child;
+    struct ring_log *ring;
+    int slot;
+
+    /* Setting up the log directory is done before taking the lock */
+    ring = NULL;
+    if ( output >= 0 ) {
+        ring = ring_log_create(log);
+    }
+
+    SDL_LockMutex(lock);
+    for ( slot=0; slot<MAX_CHILDREN; ++slot ) {
+        if ( ! children[slot].pid ) {
+            break;
+        }
+    }
+    if ( slot == MAX_CHILDREN ) {
+        SDL_UnlockMutex(lock);
+        if ( output >= 0 ) {
+            close(output);
+        }
+        ring_log_destroy(ring);
+        return(-1);
+    }
+    child = &children[slot];
+    child->pid = pid;
+    child->pidfd = -1;
+    child->exited = 0;
+    child->output = output;
+    child->log = ring;
+    if ( (output >= 0) && ! child->log ) {
+        close_output(child);
+    }
+    if ( watcher ) {
+        if ( ! use_sigchld ) {
+            child->pidfd = open_pidfd(pid);
+            if ( child->pidfd < 0 ) {
+                catch_sigchld();
+            } else {
+                fcntl(child->pidfd, F_SETFD, FD_CLOEXEC);
+            }
+        }
+        /* The child may already be gone, so always take another look */
+        wake_watcher();
+    }
+    SDL_UnlockMutex(lock);
+    return(0);
+}
+
+/* Hand back the results for a child and forget about it */
+static void collect_child(struct child *child, int *status, struct rusage *usage)
+{
+    if ( status ) {
+        *status = child->status;
+    }
+    if ( usage ) {
+        *usage = child->usage;
+    }
+    child->pid = 0;
+}
+
+int child_proc_reap(pid_t pid, int *status, struct rusage *usage)
+{
+    int slot, result;
+
+    SDL_LockMutex(lock);
+    slot = find_child(pid);
+    if ( slot < 0 ) {
+        result = -1;
+    } else {
+        if ( ! watcher ) {
+            reap_children();
+        }
+        if ( children[slot].exited ) {
+            collect_child(&children[slot], status, usage);
+            result = 1;
+        } else {
+            result = 0;
+        }
+    }
+    SDL_UnlockMutex(lock);
+    return(result);
+}
+
+int child_proc_wait(pid_t pid, int *status, struct rusage *usage)
+{
+    struct child *child;
+    int slot;
+
+    SDL_LockMutex(lock);
+    slot = find_child(pid);
+    if ( slot < 0 ) {
+        SDL_UnlockMutex(lock);
+        return(-1);
+    }
+    child = &children[slot];
+    if ( watcher ) {
+        while ( ! child->exited ) {
+            SDL_WaitCondition(child_exited, lock);
+        }
+    } else if ( ! child->exited ) {
+        while ( wait4(pid, &child->status, 0, &child->usage) < 0 ) {
+            if ( errno != EINTR ) {
+                child->status = -1;
+                memset(&child->usage, 0, sizeof(child->usage));
+                break;
+            }
+        }
+        child->exited = 1;
+    }
+    collect_child(child, status, usage);
+    SDL_UnlockMutex(lock);
+    return(0);
+}
+
+int child_proc_running(void)
+{
+    int i, count;
+
+    count = 0;
+    SDL_LockMutex(lock);
+    for ( i=0; i<MAX_CHILDREN; ++i ) {
+        if ( children[i].pid && ! children[i].exited ) {
+            ++count;
+        }
+    }
+    SDL_UnlockMutex(lock);
+    return(count);
+}
+
+void child_proc_quit(void)
+{
+    int i;
+
+    if ( watcher ) {
+        SDL_LockMutex(lock);
+        quitting = 1;
+        wake_watcher();
+        SDL_UnlockMutex(lock);
+        SDL_WaitThread(watcher, NULL);
+        watcher = NULL;
+    }
+    if ( use_sigchld ) {
+        signal(SIGCHLD, SIG_DFL);
+        use_sigchld = 0;
+    }
+    for ( i=0; i<MAX_CHILDREN; ++i ) {
+        if ( children[i].pid && (children[i].pidfd >= 0) ) {
+            close(children[i].pidfd);
+        }
+        if ( children[i].pid ) {
+            close_output(&children[i]);
+        }
+    }
+    memset(children, 0, sizeof(children));
+    save_output(unsaved);
+    unsaved = unsaved_tail = NULL;
+    for ( i=0; i<2; ++i ) {
+        if ( wake_pipe[i] >= 0 ) {
+            close(wake_pipe[i]);
+            wake_pipe[i] = -1;
+        }
+    }
+    if ( child_exited ) {
+        SDL_DestroyCondition(child_exited);
+        child_exited = NULL;
+    }
+    if ( lock ) {
+        SDL_DestroyMutex(lock);
+        lock = NULL;
+    }
+}
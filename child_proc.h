@@ -0,0 +1,80 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Supervision of the processes started by the launcher
+
+   A helper thread waits on a pidfd for each child process, or on a pipe
+   written from a SIGCHLD handler on kernels without pidfd support, and
+   reaps the children as soon as they exit.  The same thread collects the
+   output of the children into their logs, so they can't block writing it.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <SDL3/SDL.h>
+
+/* Start a command line from launch.txt, without waiting for it.
+   Simple command lines are split into arguments and run directly, the
+   shell is only used if the line needs it.  If env isn't NULL, it is the
+   environment for the new process.
+   If output isn't NULL, the stdout and stderr of the new process go to a
+   pipe, and output is set to the end to pass to child_proc_watch(), or to
+   -1 if there is no watcher thread to collect it.
+   This returns the pid of the new process, or -1 if it couldn't be run.
+ */
+extern pid_t child_proc_spawn(const char *command, char **env, int *output);
+
+/* Find the program that a command line from launch.txt would run.
+   This returns 0, or -1 if the program couldn't be found.
+ */
+extern int child_proc_program(const char *command, char *program, int maxlen);
+
+/* Start the thread that watches for child processes to exit.
+   If event_type is not 0, an SDL event of that type is pushed whenever a
+   watched child exits, with the pid of the child in event.user.code.
+   This returns 0, or -1 if the thread couldn't be started, in which case
+   children have to be checked with child_proc_reap().
+ */
+extern int child_proc_init(Uint32 event_type);
+
+/* Watch a child process that was just started.
+   If output isn't -1, it is the output pipe from child_proc_spawn(), and
+   what the child prints is kept in ~/.loki/loki_demos/logs/<log>.log
+   This returns 0, or -1 if there are too many children being watched.
+ */
+extern int child_proc_watch(pid_t pid, int output, const char *log);
+
+/* Collect a watched child process if it has exited, without blocking.
+   This returns 1 and fills in the exit status and resource usage if the
+   child is done, 0 if it is still running, or -1 if it isn't being watched.
+   Either status or usage may be NULL.
+ */
+extern int child_proc_reap(pid_t pid, int *status, struct rusage *usage);
+
+/* Wait for a watched child process to exit, and collect it.
+   This returns 0, or -1 if the child isn't being watched.
+ */
+extern int child_proc_wait(pid_t pid, int *status, struct rusage *usage);
+
+/* Return the number of watched children that haven't been collected */
+extern int child_proc_running(void);
+
+/* Stop the watcher thread, any remaining children are left alone */
+extern void child_proc_quit(void);
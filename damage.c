@@ -0,0 +1,123 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* The parts of the window that need to be presented */
+
+#include <string.h>
+
+#include <SDL3/SDL.h>
+#include "damage.h"
+
+static SDL_Rect bounds;
+static SDL_Rect rects[DAMAGE_MAX_RECTS];
+static int num_rects;
+static struct damage_stats stats;
+
+static Uint64 area_of(const SDL_Rect *rect)
+{
+    return((Uint64)rect->w * rect->h);
+}
+
+/* Merge b into a if the rectangle covering both isn't much bigger than
+   the two of them.  This returns 1 if they were merged.
+ */
+static int try_merge(SDL_Rect *a, const SDL_Rect *b)
+{
+    SDL_Rect both, overlap;
+    Uint64 covered;
+
+    SDL_GetRectUnion(a, b, &both);
+    covered = area_of(a) + area_of(b);
+    if ( SDL_GetRectIntersection(a, b, &overlap) ) {
+        covered -= area_of(&overlap);
+    }
+    if ( area_of(&both) - covered > DAMAGE_SLACK ) {
+        return(0);
+    }
+    *a = both;
+    return(1);
+}
+
+void damage_reset(int w, int h)
+{
+    bounds.x = 0;
+    bounds.y = 0;
+    bounds.w = w;
+    bounds.h = h;
+    num_rects = 0;
+}
+
+void damage_add(const SDL_Rect *area)
+{
+    SDL_Rect rect;
+    int i;
+
+    if ( ! SDL_GetRectIntersection(area, &bounds, &rect) ) {
+        return;
+    }
+    stats.requested += area_of(&rect);
+
+    /* Keep merging, since the bigger rectangle may now reach others */
+    for ( i=0; i<num_rects; ) {
+        if ( try_merge(&rect, &rects[i]) ) {
+            rects[i] = rects[--num_rects];
+            i = 0;
+        } else {
+            ++i;
+        }
+    }
+
+    /* Too many separate changes, present the area around all of them */
+    if ( num_rects == DAMAGE_MAX_RECTS ) {
+        for ( i=0; i<num_rects; ++i ) {
+            SDL_GetRectUnion(&rect, &rects[i], &rect);
+        }
+        num_rects = 0;
+        if ( area_of(&rect)*100 >= area_of(&bounds)*DAMAGE_FULL_PERCENT ) {
+            rect = bounds;
+        }
+    }
+    rects[num_rects++] = rect;
+}
+
+int damage_take(const SDL_Rect **list)
+{
+    int i, count;
+
+    count = num_rects;
+    if ( count ) {
+        ++stats.frames;
+        stats.rects += count;
+        for ( i=0; i<count; ++i ) {
+            stats.pushed += area_of(&rects[i]);
+        }
+    }
+    num_rects = 0;
+    *list = rects;
+    return(count);
+}
+
+void damage_get_stats(struct damage_stats *copy, int clear)
+{
+    *copy = stats;
+    if ( clear ) {
+        memset(&stats, 0, sizeof(stats));
+    }
+}
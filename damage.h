@@ -0,0 +1,55 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* The parts of the window that need to be presented
+
+   Rectangles added during a frame are merged whenever that doesn't cost
+   many extra pixels, so overlapping and adjacent updates are pushed once.
+   If there are still too many rectangles, the frame falls back to their
+   bounding box, or to the whole window when that is most of it anyway.
+ */
+
+#include <SDL3/SDL.h>
+
+#define DAMAGE_MAX_RECTS    32      /* Rectangles presented per frame */
+#define DAMAGE_SLACK        4096    /* Extra pixels a merge may add */
+#define DAMAGE_FULL_PERCENT 75      /* Bounding box size to present it all */
+
+struct damage_stats {
+    Uint64 frames;          /* Frames presented */
+    Uint64 rects;           /* Rectangles presented */
+    Uint64 requested;       /* Pixels added, counting overlaps */
+    Uint64 pushed;          /* Pixels presented */
+};
+
+/* Start over with a window of the given size, and nothing to present */
+extern void damage_reset(int w, int h);
+
+/* Add a part of the window that has changed */
+extern void damage_add(const SDL_Rect *area);
+
+/* Get the rectangles to present for this frame, and start the next one.
+   This returns the number of rectangles, which are valid until the next
+   call to damage_add().
+ */
+extern int damage_take(const SDL_Rect **rects);
+
+/* Get the counters since they were last cleared, and clear them if asked */
+extern void damage_get_stats(struct damage_stats *stats, int clear);
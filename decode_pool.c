@@ -0,0 +1,262 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* A pool of worker threads that decode artwork in the background */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "decode_pool.h"
+
+#define MAX_THREADS 16
+
+/* A single image waiting to be decoded */
+struct decode_job {
+    SDL_Surface **result;
+    struct decode_job *next;
+    char path[1];   /* Allocated with the rest of the job */
+};
+
+static decode_func decoder;
+static int num_workers;
+static SDL_Thread *workers[MAX_THREADS];
+static SDL_Mutex *lock;
+static SDL_Condition *work_ready;
+static SDL_Condition *work_done;
+static struct decode_job *queue_head, *queue_tail;
+static SDL_Surface **decoding[MAX_THREADS];    /* The jobs in progress */
+static int pending;
+static int quitting;
+static Uint32 notify_event;
+
+static int decode_worker(void *data)
+{
+    int worker = (int)(intptr_t)data;
+    struct decode_job *job;
+    SDL_Surface *surface;
+
+    SDL_LockMutex(lock);
+    for ( ; ; ) {
+        while ( ! queue_head && ! quitting ) {
+            SDL_WaitCondition(work_ready, lock);
+        }
+        if ( ! queue_head ) {
+            break;
+        }
+        job = queue_head;
+        queue_head = job->next;
+        if ( ! queue_head ) {
+            queue_tail = NULL;
+        }
+        decoding[worker] = job->result;
+        SDL_UnlockMutex(lock);
+
+        /* Do the actual decoding without holding the lock */
+        surface = decoder(job->path);
+
+        SDL_LockMutex(lock);
+        *job->result = surface;
+        decoding[worker] = NULL;
+        free(job);
+        SDL_BroadcastCondition(work_done);
+        if ( --pending == 0 ) {
+            if ( notify_event ) {
+                SDL_Event event;
+
+                SDL_zero(event);
+                event.type = notify_event;
+                SDL_PushEvent(&event);
+            }
+        }
+    }
+    SDL_UnlockMutex(lock);
+    return(0);
+}
+
+int decode_pool_init(int num_threads, decode_func decode)
+{
+    decoder = decode;
+    if ( num_threads < 0 ) {
+        num_threads = SDL_GetNumLogicalCPUCores();
+    }
+    if ( num_threads > MAX_THREADS ) {
+        num_threads = MAX_THREADS;
+    }
+    if ( num_threads <= 0 ) {
+        return(0);
+    }
+
+    lock = SDL_CreateMutex();
+    work_ready = SDL_CreateCondition();
+    work_done = SDL_CreateCondition();
+    if ( ! lock || ! work_ready || ! work_done ) {
+        fprintf(stderr, "Couldn't create decoder pool: %s\n", SDL_GetError());
+        decode_pool_quit();
+        return(-1);
+    }
+    quitting = 0;
+    for ( num_workers=0; num_workers<num_threads; ++num_workers ) {
+        workers[num_workers] = SDL_CreateThread(decode_worker, "decoder",
+                                                (void *)(intptr_t)num_workers);
+        if ( ! workers[num_workers] ) {
+            break;
+        }
+    }
+    if ( num_workers == 0 ) {
+        fprintf(stderr, "Couldn't create decoder thread: %s\n", SDL_GetError());
+        decode_pool_quit();
+        return(-1);
+    }
+    return(0);
+}
+
+void decode_pool_submit(const char *path, SDL_Surface **result)
+{
+    struct decode_job *job;
+
+    /* Without any worker threads we just decode it right here */
+    if ( num_workers == 0 ) {
+        *result = decoder(path);
+        return;
+    }
+
+    job = (struct decode_job *)malloc(sizeof *job + strlen(path));
+    if ( ! job ) {
+        *result = decoder(path);
+        return;
+    }
+    strcpy(job->path, path);
+    job->result = result;
+    job->next = NULL;
+    *result = NULL;
+
+    SDL_LockMutex(lock);
+    if ( queue_tail ) {
+        queue_tail->next = job;
+    } else {
+        queue_head = job;
+    }
+    queue_tail = job;
+    ++pending;
+    SDL_SignalCondition(work_ready);
+    SDL_UnlockMutex(lock);
+}
+
+void decode_pool_notify(Uint32 event_type)
+{
+    notify_event = event_type;
+}
+
+int decode_pool_pending(void)
+{
+    int count;
+
+    if ( num_workers == 0 ) {
+        return(0);
+    }
+    SDL_LockMutex(lock);
+    count = pending;
+    SDL_UnlockMutex(lock);
+    return(count);
+}
+
+void decode_pool_wait(void)
+{
+    if ( num_workers == 0 ) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    while ( pending > 0 ) {
+        SDL_WaitCondition(work_done, lock);
+    }
+    SDL_UnlockMutex(lock);
+}
+
+/* See if an image is still being decoded, this is called with the lock */
+static int is_decoding(SDL_Surface **result)
+{
+    struct decode_job *job, *prev;
+    int i;
+
+    for ( i=0; i<num_workers; ++i ) {
+        if ( decoding[i] == result ) {
+            return(1);
+        }
+    }
+    prev = NULL;
+    for ( job=queue_head; job; job=job->next ) {
+        if ( job->result == result ) {
+            /* Nobody has started on it, so it goes next */
+            if ( prev ) {
+                prev->next = job->next;
+                if ( queue_tail == job ) {
+                    queue_tail = prev;
+                }
+                job->next = queue_head;
+                queue_head = job;
+            }
+            return(1);
+        }
+        prev = job;
+    }
+    return(0);
+}
+
+void decode_pool_wait_for(SDL_Surface **result)
+{
+    if ( num_workers == 0 ) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    while ( is_decoding(result) ) {
+        SDL_WaitCondition(work_done, lock);
+    }
+    SDL_UnlockMutex(lock);
+}
+
+void decode_pool_quit(void)
+{
+    int i;
+
+    if ( num_workers > 0 ) {
+        SDL_LockMutex(lock);
+        quitting = 1;
+        SDL_BroadcastCondition(work_ready);
+        SDL_UnlockMutex(lock);
+        for ( i=0; i<num_workers; ++i ) {
+            SDL_WaitThread(workers[i], NULL);
+        }
+        num_workers = 0;
+    }
+    if ( work_done ) {
+        SDL_DestroyCondition(work_done);
+        work_done = NULL;
+    }
+    if ( work_ready ) {
+        SDL_DestroyCondition(work_ready);
+        work_ready = NULL;
+    }
+    if ( lock ) {
+        SDL_DestroyMutex(lock);
+        lock = NULL;
+    }
+}
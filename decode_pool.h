@@ -0,0 +1,61 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* A pool of worker threads that decode artwork in the background */
+
+#include <SDL3/SDL.h>
+
+/* The function used to turn a file into a surface, e.g. IMG_Load() */
+typedef SDL_Surface *(*decode_func)(const char *path);
+
+/* Start the decoder threads.
+   If num_threads is negative, one thread per logical CPU core is used.
+   If num_threads is 0, images are decoded serially in decode_pool_submit().
+   This function returns 0, or -1 if the threads couldn't be created, in
+   which case the pool falls back to serial decoding.
+ */
+extern int decode_pool_init(int num_threads, decode_func decode);
+
+/* Queue an image to be decoded.
+   The surface is stored in *result by a worker thread, so *result must not
+   be looked at until decode_pool_wait() or decode_pool_wait_for() returns.
+ */
+extern void decode_pool_submit(const char *path, SDL_Surface **result);
+
+/* Push an SDL event of the given type whenever the queue has been drained,
+   so the main loop can sleep while images are being decoded.
+   An event type of 0 turns this off.
+ */
+extern void decode_pool_notify(Uint32 event_type);
+
+/* Return the number of images that have been queued but not yet decoded */
+extern int decode_pool_pending(void);
+
+/* Wait for every queued image to finish decoding */
+extern void decode_pool_wait(void);
+
+/* Wait for just the image that is being decoded into *result, moving it
+   to the front of the queue if no worker has started on it yet.
+   This returns right away if that image isn't queued.
+ */
+extern void decode_pool_wait_for(SDL_Surface **result);
+
+/* Stop the decoder threads, after finishing any queued work */
+extern void decode_pool_quit(void);
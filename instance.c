@@ -0,0 +1,324 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Only one menu runs at a time */
+
+#define _GNU_SOURCE     /* For accept4() */
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/file.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <SDL3/SDL.h>
+#include "instance.h"
+
+#define MAX_REQUESTS    4096    /* The most we'll take from one menu */
+#define REQUEST_TIMEOUT 1000    /* Milliseconds to wait for the requests */
+
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static int listen_fd = -1;
+static int wake_pipe[2] = { -1, -1 };
+static Uint32 request_event;
+static SDL_Thread *listener;
+
+static int get_address(struct sockaddr_un *addr)
+{
+    const char *dir;
+
+    dir = getenv("XDG_RUNTIME_DIR");
+    if ( ! dir || ! *dir ) {
+        return(-1);
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if ( snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/%s",
+                  dir, INSTANCE_SOCKET) >= sizeof(addr->sun_path) ) {
+        return(-1);
+    }
+    return(0);
+}
+
+/* Lock out other menus while the socket is being taken over or removed.
+   This returns the lock file descriptor, to be closed to unlock it, or -1.
+ */
+static int lock_socket(const char *path)
+{
+    char lock_path[PATH_MAX];
+    int fd;
+
+    if ( snprintf(lock_path, sizeof(lock_path), "%s%s",
+                  path, INSTANCE_LOCK) >= sizeof(lock_path) ) {
+        return(-1);
+    }
+    fd = open(lock_path, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+    if ( fd < 0 ) {
+        return(-1);
+    }
+    while ( flock(fd, LOCK_EX) < 0 ) {
+        if ( errno != EINTR ) {
+            close(fd);
+            return(-1);
+        }
+    }
+    return(fd);
+}
+
+/* Send the requests to a running menu.
+   This returns 1 if they were sent, 0 if there is no menu, or -1 if the
+   menu that is there couldn't take them.
+ */
+static int send_requests(const struct sockaddr_un *addr, const char *requests)
+{
+    int fd, len, result;
+
+    fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+    if ( fd < 0 ) {
+        return(-1);
+    }
+    if ( connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0 ) {
+        if ( errno == ECONNREFUSED ) {
+            /* Left behind by a menu that didn't exit cleanly */
+            unlink(addr->sun_path);
+            result = 0;
+        } else {
+            result = (errno == ENOENT) ? 0 : -1;
+        }
+        close(fd);
+        return(result);
+    }
+    result = 1;
+    len = strlen(requests);
+    while ( len > 0 ) {
+        ssize_t sent = write(fd, requests, len);
+        if ( sent < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        requests += sent;
+        len -= sent;
+    }
+    close(fd);
+    return(result);
+}
+
+int instance_forward(const char *requests)
+{
+    struct sockaddr_un addr;
+    int lock_fd, result;
+
+    if ( get_address(&addr) < 0 ) {
+        return(-1);
+    }
+
+    /* Hold the lock from finding a stale socket until ours is listening,
+       so a menu starting at the same time can't remove it in between.
+     */
+    lock_fd = lock_socket(addr.sun_path);
+    if ( lock_fd < 0 ) {
+        return(-1);
+    }
+    result = send_requests(&addr, requests);
+    if ( result == 0 ) {
+        /* There's nobody there, so we're the first */
+        result = -1;
+        listen_fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        if ( (listen_fd >= 0) &&
+             (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) &&
+             (listen(listen_fd, 8) == 0) ) {
+            strcpy(socket_path, addr.sun_path);
+            result = 0;
+        } else if ( listen_fd >= 0 ) {
+            close(listen_fd);
+            listen_fd = -1;
+        }
+    }
+    close(lock_fd);
+    return(result);
+}
+
+void instance_post(const char *requests)
+{
+    const char *next;
+    SDL_Event event;
+    char *line;
+    int len;
+
+    for ( ; *requests; requests = next ) {
+        next = strchr(requests, '\n');
+        if ( next ) {
+            len = next - requests;
+            ++next;
+        } else {
+            len = strlen(requests);
+            next = requests + len;
+        }
+        if ( len == 0 ) {
+            continue;
+        }
+        line = (char *)malloc(len+1);
+        if ( ! line ) {
+            break;
+        }
+        memcpy(line, requests, len);
+        line[len] = '\0';
+
+        SDL_zero(event);
+        event.type = request_event;
+        event.user.data1 = line;
+        if ( ! SDL_PushEvent(&event) ) {
+            free(line);
+        }
+    }
+}
+
+/* Take the requests from another menu, which closes the connection
+   once they have all been sent
+ */
+static void read_requests(int fd)
+{
+    struct pollfd pfd;
+    char *requests;
+    int len;
+    ssize_t got;
+
+    requests = (char *)malloc(MAX_REQUESTS+1);
+    if ( ! requests ) {
+        return;
+    }
+    len = 0;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while ( (len < MAX_REQUESTS) && (poll(&pfd, 1, REQUEST_TIMEOUT) > 0) ) {
+        got = read(fd, requests+len, MAX_REQUESTS-len);
+        if ( got <= 0 ) {
+            if ( (got < 0) && (errno == EINTR) ) {
+                continue;
+            }
+            break;
+        }
+        len += got;
+    }
+    requests[len] = '\0';
+    instance_post(requests);
+    free(requests);
+}
+
+static int instance_listener(void *unused)
+{
+    struct pollfd fds[2];
+    char buf[64];
+    int fd;
+
+    fds[0].fd = wake_pipe[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = listen_fd;
+    fds[1].events = POLLIN;
+    for ( ; ; ) {
+        if ( poll(fds, 2, -1) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            break;
+        }
+        if ( fds[0].revents ) {
+            /* Time to quit */
+            while ( read(wake_pipe[0], buf, sizeof(buf)) > 0 ) {
+                continue;
+            }
+            break;
+        }
+        if ( fds[1].revents & POLLIN ) {
+            fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if ( fd >= 0 ) {
+                read_requests(fd);
+                close(fd);
+            }
+        }
+    }
+    return(0);
+}
+
+int instance_listen(Uint32 event_type)
+{
+    int i;
+
+    request_event = event_type;
+    if ( listen_fd < 0 ) {
+        return(-1);
+    }
+    if ( pipe(wake_pipe) < 0 ) {
+        wake_pipe[0] = wake_pipe[1] = -1;
+        return(-1);
+    }
+    for ( i=0; i<2; ++i ) {
+        fcntl(wake_pipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(wake_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    listener = SDL_CreateThread(instance_listener, "instance_listener", NULL);
+    if ( ! listener ) {
+        fprintf(stderr, "Couldn't create instance listener thread: %s\n",
+                SDL_GetError());
+        return(-1);
+    }
+    return(0);
+}
+
+void instance_quit(void)
+{
+    char c = 0;
+    int i, lock_fd;
+
+    if ( listener ) {
+        if ( write(wake_pipe[1], &c, 1) < 0 ) {
+            /* The listener is already on its way out */
+        }
+        SDL_WaitThread(listener, NULL);
+        listener = NULL;
+    }
+    for ( i=0; i<2; ++i ) {
+        if ( wake_pipe[i] >= 0 ) {
+            close(wake_pipe[i]);
+            wake_pipe[i] = -1;
+        }
+    }
+    if ( listen_fd >= 0 ) {
+        /* Remove the socket while it still answers, so a menu starting
+           now can't take it over just before it goes away
+         */
+        lock_fd = lock_socket(socket_path);
+        unlink(socket_path);
+        close(listen_fd);
+        listen_fd = -1;
+        if ( lock_fd >= 0 ) {
+            close(lock_fd);
+        }
+    }
+}
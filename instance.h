@@ -0,0 +1,57 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Only one menu runs at a time
+
+   The first menu listens on a UNIX socket in $XDG_RUNTIME_DIR.  Starting
+   the menu again sends its requests down the socket and exits right away,
+   without initializing SDL.  Taking over a stale socket and removing it
+   are done under an flock() on a lock file next to the socket.
+   Requests are lines of text:
+        raise           Bring the menu window to the front
+        select <demo>   Select a demo
+        play <demo>     Launch a demo
+   Requests that arrive while a demo is running are handled once it exits.
+ */
+
+#include <SDL3/SDL.h>
+
+#define INSTANCE_SOCKET "loki_demos.socket"
+#define INSTANCE_LOCK   ".lock"         /* Appended to the socket path */
+
+/* Hand the requests, one per line, to the menu that is already running,
+   or else become the menu that the next ones are sent to.
+   This returns 1 if the requests were sent, 0 if we are the first menu,
+   or -1 if the menu can't be shared, in which case it just runs alone.
+ */
+extern int instance_forward(const char *requests);
+
+/* Start listening for requests from other menus.
+   Each request is pushed as an SDL event of the given type, with the
+   request line in event.user.data1, to be freed by the receiver.
+   This returns 0, or -1 if requests can't be received.
+ */
+extern int instance_listen(Uint32 event_type);
+
+/* Push SDL events for requests, as if another menu had sent them */
+extern void instance_post(const char *requests);
+
+/* Stop listening, and remove the socket */
+extern void instance_quit(void);
@@ -0,0 +1,287 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* How demos are scheduled while they run */
+
+#define _GNU_SOURCE     /* For sched_setaffinity() and SCHED_IDLE */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+
+#include <SDL3/SDL.h>
+#include "launch_policy.h"
+#include "child_proc.h"
+
+/* From linux/ioprio.h */
+#define IOPRIO_CLASS_SHIFT      13
+#define IOPRIO_PRIO_VALUE(class, data)  (((class) << IOPRIO_CLASS_SHIFT) | (data))
+#define IOPRIO_WHO_PROCESS      1
+
+#define POLICY_NICE     0x01
+#define POLICY_IOPRIO   0x02
+#define POLICY_CPUS     0x04
+
+struct launch_policy {
+    int set;
+    int nice;
+    int ioprio;
+    cpu_set_t cpus;
+};
+
+static struct {
+    const char *name;
+    int value;
+} ioprio_classes[] = {
+    { "rt",   1 },
+    { "be",   2 },
+    { "idle", 3 }
+};
+
+/* Parse a list of CPUs like "0-3,6", returning 0 or -1 if it's invalid */
+static int parse_cpus(const char *list, cpu_set_t *cpus)
+{
+    char *end;
+    long first, last;
+
+    CPU_ZERO(cpus);
+    while ( *list ) {
+        first = strtol(list, &end, 10);
+        if ( (end == list) || (first < 0) ) {
+            return(-1);
+        }
+        last = first;
+        if ( *end == '-' ) {
+            list = end+1;
+            last = strtol(list, &end, 10);
+            if ( (end == list) || (last < first) ) {
+                return(-1);
+            }
+        }
+        for ( ; (first <= last) && (first < CPU_SETSIZE); ++first ) {
+            CPU_SET(first, cpus);
+        }
+        list = end;
+        if ( *list == ',' ) {
+            ++list;
+        } else if ( *list ) {
+            return(-1);
+        }
+    }
+    return(CPU_COUNT(cpus) ? 0 : -1);
+}
+
+static int parse_ioprio(char *value, int *ioprio)
+{
+    char *level;
+    int i;
+
+    level = strchr(value, ' ');
+    if ( level ) {
+        *level++ = '\0';
+    }
+    for ( i=0; i<(sizeof ioprio_classes)/(sizeof ioprio_classes[0]); ++i ) {
+        if ( strcasecmp(value, ioprio_classes[i].name) == 0 ) {
+            *ioprio = IOPRIO_PRIO_VALUE(ioprio_classes[i].value,
+                                        level ? atoi(level) & 7 : 4);
+            return(0);
+        }
+    }
+    return(-1);
+}
+
+static int load_policy(const char *demo, struct launch_policy *policy)
+{
+    char path[PATH_MAX];
+    char line[1024];
+    char *key, *value, *end;
+    FILE *fp;
+
+    /* The user's preferences come first, like launch.txt */
+    snprintf(path, sizeof(path), "%s/.loki/loki_demos/%s/policy.txt",
+             getenv("HOME"), demo);
+    fp = fopen(path, "r");
+    if ( ! fp ) {
+        snprintf(path, sizeof(path), "demos/%s/launch/policy.txt", demo);
+        fp = fopen(path, "r");
+        if ( ! fp ) {
+            return(-1);
+        }
+    }
+
+    memset(policy, 0, sizeof(*policy));
+    while ( fgets(line, sizeof(line), fp) ) {
+        line[strcspn(line, "#\r\n")] = '\0';
+        for ( key=line; isspace((unsigned char)*key); ++key ) {
+            continue;
+        }
+        if ( ! *key ) {
+            continue;
+        }
+        value = key + strcspn(key, " \t");
+        if ( *value ) {
+            *value++ = '\0';
+            value += strspn(value, " \t");
+        }
+        for ( end=value+strlen(value); (end > value) &&
+                                        isspace((unsigned char)end[-1]); ) {
+            *--end = '\0';
+        }
+
+        if ( strcasecmp(key, "nice") == 0 ) {
+            policy->nice = atoi(value);
+            policy->set |= POLICY_NICE;
+        } else
+        if ( (strcasecmp(key, "ioprio") == 0) &&
+             (parse_ioprio(value, &policy->ioprio) == 0) ) {
+            policy->set |= POLICY_IOPRIO;
+        } else
+        if ( (strcasecmp(key, "cpus") == 0) &&
+             (parse_cpus(value, &policy->cpus) == 0) ) {
+            policy->set |= POLICY_CPUS;
+        } else {
+            fprintf(stderr, "Warning: ignoring \"%s %s\" in %s\n",
+                    key, value, path);
+        }
+    }
+    fclose(fp);
+    return(0);
+}
+
+/* Apply a policy to the calling thread.  On Linux each of these only
+   changes a single thread, and new processes inherit them from the
+   thread that creates them.
+ */
+static void apply_policy(const char *demo, const struct launch_policy *policy)
+{
+    if ( (policy->set & POLICY_NICE) &&
+         (setpriority(PRIO_PROCESS, 0, policy->nice) < 0) ) {
+        fprintf(stderr, "Warning: couldn't set nice %d for %s: %s\n",
+                policy->nice, demo, strerror(errno));
+    }
+#ifdef SYS_ioprio_set
+    if ( (policy->set & POLICY_IOPRIO) &&
+         (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, policy->ioprio) < 0) ) {
+        fprintf(stderr, "Warning: couldn't set I/O priority for %s: %s\n",
+                demo, strerror(errno));
+    }
+#endif
+    if ( (policy->set & POLICY_CPUS) &&
+         (sched_setaffinity(0, sizeof(policy->cpus), &policy->cpus) < 0) ) {
+        fprintf(stderr, "Warning: couldn't set CPU affinity for %s: %s\n",
+                demo, strerror(errno));
+    }
+}
+
+struct spawn_request {
+    const char *demo;
+    const struct launch_policy *policy;
+    const char *command;
+    char **env;
+    int *output;
+    pid_t pid;
+};
+
+/* A thread that takes on the policy and starts the demo.  The policy
+   can't always be undone, a lower nice value needs privileges, so the
+   thread is thrown away afterwards.
+ */
+static int spawn_thread(void *data)
+{
+    struct spawn_request *request = (struct spawn_request *)data;
+
+    apply_policy(request->demo, request->policy);
+    request->pid = child_proc_spawn(request->command, request->env,
+                                    request->output);
+    return(0);
+}
+
+pid_t launch_policy_spawn(const char *demo, const char *command,
+                          char **env, int *output)
+{
+    struct launch_policy policy;
+    struct spawn_request request;
+    SDL_Thread *thread;
+
+    if ( ! demo || (load_policy(demo, &policy) < 0) ) {
+        return(child_proc_spawn(command, env, output));
+    }
+
+    request.demo = demo;
+    request.policy = &policy;
+    request.command = command;
+    request.env = env;
+    request.output = output;
+    request.pid = -1;
+    thread = SDL_CreateThread(spawn_thread, "launch_policy", &request);
+    if ( ! thread ) {
+        fprintf(stderr, "Warning: couldn't apply the policy for %s: %s\n",
+                demo, SDL_GetError());
+        return(child_proc_spawn(command, env, output));
+    }
+    SDL_WaitThread(thread, NULL);
+    return(request.pid);
+}
+
+int launch_policy_idle(void)
+{
+    struct sched_param param;
+    struct rlimit limit;
+    int policy, nice;
+
+    /* Leave real time and other special policies alone */
+    policy = sched_getscheduler(0);
+    if ( policy != SCHED_OTHER ) {
+        return(-1);
+    }
+
+    /* Leaving SCHED_IDLE needs RLIMIT_NICE to allow our nice value */
+    errno = 0;
+    nice = getpriority(PRIO_PROCESS, 0);
+    memset(&param, 0, sizeof(param));
+    if ( (errno == 0) && (getrlimit(RLIMIT_NICE, &limit) == 0) &&
+         ((limit.rlim_cur == RLIM_INFINITY) ||
+          ((rlim_t)(20 - nice) <= limit.rlim_cur)) &&
+         (sched_setscheduler(0, SCHED_IDLE, &param) == 0) ) {
+        return(policy);
+    }
+    if ( sched_setscheduler(0, SCHED_BATCH, &param) == 0 ) {
+        return(policy);
+    }
+    return(-1);
+}
+
+void launch_policy_resume(int policy)
+{
+    struct sched_param param;
+
+    if ( policy >= 0 ) {
+        memset(&param, 0, sizeof(param));
+        sched_setscheduler(0, policy, &param);
+    }
+}
@@ -0,0 +1,54 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* How demos are scheduled while they run
+
+   A demo can have a policy.txt next to its launch.txt, either in the
+   user's ~/.loki/loki_demos/<demo>/ or in the demo's launch directory,
+   with lines like these:
+        nice 5
+        ioprio be 2
+        cpus 0-1,3
+   The nice value, I/O priority (class rt, be or idle, and a level from 0
+   to 7) and the CPUs the demo may run on are applied to a thread that
+   then starts the demo, so the demo has them from its first instruction
+   and every thread and process it creates inherits them.  Only changes
+   an unprivileged user may make will take effect, anything else is
+   skipped with a warning.
+ */
+
+#include <sys/types.h>
+
+/* Start a demo with child_proc_spawn(), under its launch policy if demo
+   isn't NULL and it has one.
+   This returns the pid of the demo, or -1 if it couldn't be run.
+ */
+extern pid_t launch_policy_spawn(const char *demo, const char *command,
+                                 char **env, int *output);
+
+/* Get the calling thread out of the way of a running demo.
+   This uses SCHED_IDLE if we are allowed to switch back afterwards, and
+   SCHED_BATCH otherwise.  It returns the policy to pass to
+   launch_policy_resume(), or -1 if nothing was changed.
+ */
+extern int launch_policy_idle(void);
+
+/* Restore the scheduling policy changed by launch_policy_idle() */
+extern void launch_policy_resume(int policy);
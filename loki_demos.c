@@ -35,6 +35,20 @@
 #include <SDL3_image/SDL_image.h>
 #include <SDL3_mixer/SDL_mixer.h>
 #include "loki_launch.h"
+#include "decode_pool.h"
+#include "artpack.h"
+#include "surface_cache.h"
+#include "surface_prep.h"
+#include "trace.h"
+#include "catalog.h"
+#include "child_proc.h"
+#include "readahead.h"
+#include "access_profile.h"
+#include "telemetry.h"
+#include "launch_policy.h"
+#include "state.h"
+#include "instance.h"
+#include "damage.h"
 
 
 #define PRODUCT     "Loki_Demos"
@@ -49,6 +63,16 @@
 #define DEMO_PANEL_XSPACE   64
 #define DEMO_PANEL_Y        100
 #define DEMO_PANEL_YSPACE   68
+#define VISIBLE_ROWS        2
+#define PREFETCH_ROWS       1
+#define HIT_CELL_SIZE       32
+#define HIT_CELL_BUTTONS    8
+#define MAX_CACHED_PANELS   8
+#define PREFETCH_DELAY      150
+#define SCROLL_DELAY        16
+#define MEASURE_INTERVAL    5000000000LL
+#define BENCH_BLITS         200
+#define MAX_DEFERRED        16
 
 /* The interface button states */
 enum {
@@ -77,8 +101,6 @@ enum {
 /* The main screen surface */
 static SDL_Surface *screen;
 static SDL_Window *window;
-static int num_dirty;
-static SDL_Rect dirty_areas[128];
 
 /* The button click sound */
 static MIX_Audio *click;
@@ -93,6 +115,8 @@ static struct button {
     const char  *files[NUM_STATES];
     SDL_Surface *frame;
     SDL_Surface *frames[NUM_STATES];
+    const SDL_Rect *clip;
+    SDL_Surface *composed[NUM_STATES];  /* See compose_button() */
 } images[] = {
     { 0,    0,      NORMAL,  0,
         { "background.png",NULL,NULL },
@@ -137,21 +161,94 @@ static struct button {
 };
 static struct button *hilited_button = NULL;
 
-/* The available demos */
+/* The loading state of the per-demo artwork */
+enum {
+    UNLOADED,
+    LOADING,
+    LOADED
+};
+
+/* The available demos, sorted by name */
 static int num_demos;
 struct demo {
     char *name;
     int row, col;
     char *trailer;
     char *website;
+    unsigned int assets;
+    int icons;
+    int panels;
     struct button box;
     struct button caption;
     struct button text;
     struct button icon;
     struct button extra;
-    struct demo *next;
 } *demos = NULL, *current_demo = NULL, *hilited_demo = NULL;
 
+/* The part of the screen the demo icons scroll through */
+static SDL_Rect demo_panel = {
+    DEMO_PANEL_X, DEMO_PANEL_Y,
+    MAX_PER_ROW*DEMO_PANEL_XSPACE, VISIBLE_ROWS*DEMO_PANEL_YSPACE
+};
+static int scroll_y, scroll_target;
+static Uint64 scroll_time;
+
+/* The demos with their icons loaded, the visible rows plus a margin */
+static int window_first, window_last;
+
+/* The buttons that could be under each part of the screen, see find_button().
+   A cell with too many buttons to hold has a count of -1, and is searched
+   the slow way.
+ */
+static struct hit_cell {
+    int count;
+    struct button *buttons[HIT_CELL_BUTTONS];
+    struct demo *demos[HIT_CELL_BUTTONS];
+} hit_index[480/HIT_CELL_SIZE][640/HIT_CELL_SIZE];
+static int hit_index_stale = 1;
+
+/* The demos with their box, text and extra artwork loaded, most recent first */
+static struct demo *recent_panels[MAX_CACHED_PANELS];
+
+/* The demo being hovered over, and when to start loading its artwork */
+static struct demo *prefetch_demo = NULL;
+static Uint64 prefetch_time;
+
+/* The event sent by the decoder threads when they run out of work */
+static Uint32 decode_event;
+
+/* The event sent when a child process exits, and how often to check for
+   that ourselves if there is no thread watching for it
+ */
+static Uint32 child_event;
+static Sint32 child_poll = -1;
+
+/* The event sent when another copy of the menu was started, and the
+   requests that arrived while a demo was being launched or played
+ */
+static Uint32 instance_event;
+static SDL_Event deferred[MAX_DEFERRED];
+static int num_deferred;
+
+/* When the play button was clicked, for the launch log */
+static Uint64 click_time;
+
+/* Whether to record what demos read the first time they are launched */
+static int record_profiles;
+
+/* How often the main loop wakes up and how quickly it responds to input,
+   reported with --measure-loop
+ */
+static int measure_loop;
+static struct {
+    Uint64 start;
+    int wakeups;
+    int idle;
+    int events;
+    Uint64 total_latency;
+    Uint64 max_latency;
+} loop_stats;
+
 static void goto_installpath(char *argv0)
 {
     char temppath[PATH_MAX];
@@ -264,13 +361,46 @@ static void free_sounds(void)
 
 static void add_dirty_rect(const SDL_Rect *area)
 {
-    dirty_areas[num_dirty++] = *area;
+    damage_add(area);
 }
 
 static void show_dirty_rects(void)
 {
-    SDL_UpdateWindowSurfaceRects(window, dirty_areas, num_dirty);
-    num_dirty = 0;
+    const SDL_Rect *rects;
+    int count;
+
+    count = damage_take(&rects);
+    if ( count ) {
+        SDL_UpdateWindowSurfaceRects(window, rects, count);
+    }
+}
+
+/* Load an image, from the prepacked artwork or the image cache if they
+   are available and current.
+   This is called from the decoder threads.
+ */
+static SDL_Surface *load_image(const char *path)
+{
+    SDL_Surface *image;
+    int kind;
+
+    /* Prepacked and cached images were prepared when they were stored */
+    TRACE_BEGIN("load_image", path);
+    image = artpack_load(path, &kind);
+    if ( ! image ) {
+        image = surface_cache_load(path, &kind);
+    }
+    if ( image ) {
+        surface_prep_known(image, kind);
+    } else {
+        image = IMG_Load(path);
+        if ( image ) {
+            image = surface_prep(image, &kind);
+            surface_cache_store(path, image, kind);
+        }
+    }
+    TRACE_END("load_image");
+    return(image);
 }
 
 static void load_button(struct button *button,
@@ -283,29 +413,69 @@ static void load_button(struct button *button,
     button->state = initial_state;
     button->sensitive = 1;
 
+    /* The frames are decoded in the background, see finish_button() */
     button->files[NORMAL] = NULL;
     if ( normal ) {
-        button->frames[NORMAL] = IMG_Load(normal);
+        decode_pool_submit(normal, &button->frames[NORMAL]);
     } else {
         button->frames[NORMAL] = NULL;
     }
     button->files[HILITE] = NULL;
     if ( hilite ) {
-        button->frames[HILITE] = IMG_Load(hilite);
+        decode_pool_submit(hilite, &button->frames[HILITE]);
     } else {
         button->frames[HILITE] = NULL;
     }
     button->files[CLICKED] = NULL;
     if ( clicked ) {
-        button->frames[CLICKED] = IMG_Load(clicked);
+        decode_pool_submit(clicked, &button->frames[CLICKED]);
     } else {
         button->frames[CLICKED] = NULL;
     }
-    button->frame = button->frames[NORMAL];
+    button->frame = NULL;
+    memset(button->composed, 0, sizeof(button->composed));
+}
+
+/* Wait for the frames of a single button, without waiting for the rest
+   of the decoding queue
+ */
+static void wait_button(struct button *button)
+{
+    int i;
+
+    for ( i=0; i<NUM_STATES; ++i ) {
+        decode_pool_wait_for(&button->frames[i]);
+    }
+}
+
+/* Call this after decode_pool_wait() to pick up the decoded frames */
+static void finish_button(struct button *button)
+{
+    if ( (button->state > NORMAL) && button->frames[button->state] ) {
+        button->frame = button->frames[button->state];
+    } else {
+        button->frame = button->frames[NORMAL];
+    }
+}
+
+/* Throw away the frames composited over the background */
+static void uncompose_button(struct button *button)
+{
+    int i;
+
+    for ( i=0; i<NUM_STATES; ++i ) {
+        if ( button->composed[i] ) {
+            SDL_DestroySurface(button->composed[i]);
+            button->composed[i] = NULL;
+        }
+    }
 }
 
 static void set_button_xy(struct button *button, int x, int y)
 {
+    if ( (x != button->x) || (y != button->y) ) {
+        uncompose_button(button);
+    }
     button->x = x;
     button->y = y;
 }
@@ -319,6 +489,24 @@ static void free_button(struct button *button)
             SDL_DestroySurface(button->frames[i]);
         }
     }
+    uncompose_button(button);
+}
+
+/* Buttons with a clip rectangle are only drawn inside of it */
+static void blit_button(SDL_Surface *src, const SDL_Rect *srcrect,
+                        struct button *button, SDL_Rect *area)
+{
+    if ( button->clip ) {
+        SDL_SetSurfaceClipRect(screen, button->clip);
+        SDL_BlitSurface(src, srcrect, screen, area);
+        SDL_SetSurfaceClipRect(screen, NULL);
+        if ( SDL_GetRectIntersection(area, button->clip, area) ) {
+            add_dirty_rect(area);
+        }
+    } else {
+        SDL_BlitSurface(src, srcrect, screen, area);
+        add_dirty_rect(area);
+    }
 }
 
 static void erase_button(struct button *button)
@@ -326,13 +514,14 @@ static void erase_button(struct button *button)
     SDL_Rect area;
     SDL_Surface *background;
 
-    background = images[BACKGROUND].frame;
-    area.x = button->x;
-    area.y = button->y;
-    area.w = button->frame->w;
-    area.h = button->frame->h;
-    SDL_BlitSurface(background, &area, screen, &area);
-    add_dirty_rect(&area);
+    if ( button->frame ) {
+        background = images[BACKGROUND].frame;
+        area.x = button->x;
+        area.y = button->y;
+        area.w = button->frame->w;
+        area.h = button->frame->h;
+        blit_button(background, &area, button, &area);
+    }
 }
 
 static void draw_button(struct button *button)
@@ -344,9 +533,86 @@ static void draw_button(struct button *button)
         area.y = button->y;
         area.w = button->frame->w;
         area.h = button->frame->h;
-        SDL_BlitSurface(button->frame, NULL, screen, &area);
-        add_dirty_rect(&area);
+        blit_button(button->frame, NULL, button, &area);
+    }
+}
+
+/* Get a frame of a button already drawn over the background, in the
+   window format, so that changing the state of the button is a plain
+   copy instead of erasing the button and blending in the new frame.
+   These are made the first time they're needed, and thrown away when
+   the button moves or the artwork is freed.
+   This returns NULL if the frame can't be composited.
+ */
+static SDL_Surface *compose_button(struct button *button, SDL_Surface *frame)
+{
+    SDL_Surface *background;
+    SDL_Surface *composed;
+    SDL_Rect area;
+    int i;
+
+    for ( i=0; i<NUM_STATES; ++i ) {
+        if ( frame == button->frames[i] ) {
+            break;
+        }
+    }
+    if ( i == NUM_STATES ) {
+        return(NULL);
+    }
+
+    /* The window format changes if a demo changed the video mode */
+    composed = button->composed[i];
+    if ( composed && (composed->format != screen->format) ) {
+        uncompose_button(button);
+        composed = NULL;
+    }
+    if ( ! composed ) {
+        background = images[BACKGROUND].frame;
+        if ( ! background ) {
+            return(NULL);
+        }
+        composed = SDL_CreateSurface(frame->w, frame->h, screen->format);
+        if ( ! composed ) {
+            return(NULL);
+        }
+        area.x = button->x;
+        area.y = button->y;
+        area.w = frame->w;
+        area.h = frame->h;
+        SDL_BlitSurface(background, &area, composed, NULL);
+        SDL_BlitSurface(frame, NULL, composed, NULL);
+        SDL_SetSurfaceBlendMode(composed, SDL_BLENDMODE_NONE);
+        button->composed[i] = composed;
+    }
+    return(composed);
+}
+
+/* Switch a visible button to another state and frame */
+static void change_button(struct button *button, int state, SDL_Surface *frame)
+{
+    SDL_Surface *composed;
+    SDL_Rect area;
+
+    /* A frame of a different size has to erase the old one first */
+    composed = NULL;
+    if ( frame && button->frame &&
+         (frame->w == button->frame->w) && (frame->h == button->frame->h) ) {
+        composed = compose_button(button, frame);
+    }
+    if ( ! composed ) {
+        erase_button(button);
+        button->state = state;
+        button->frame = frame;
+        draw_button(button);
+        return;
     }
+    button->state = state;
+    button->frame = frame;
+    area.x = button->x;
+    area.y = button->y;
+    area.w = frame->w;
+    area.h = frame->h;
+    blit_button(composed, NULL, button, &area);
 }
 
 static void hide_button(struct button *button)
@@ -373,10 +639,7 @@ static void reset_button(struct button *button)
     if ( button ) {
         if ( (button->state != NORMAL) && (button->state != HIDDEN) ) {
             if ( !current_demo || (button != &current_demo->icon) ) {
-                erase_button(button);
-                button->state = NORMAL;
-                button->frame = button->frames[button->state];
-                draw_button(button);
+                change_button(button, NORMAL, button->frames[NORMAL]);
             }
         }
         if ( hilited_button == button ) {
@@ -392,12 +655,8 @@ static void hilite_button(struct button *button)
             reset_button(hilited_button);
             hilited_button = button;
         }
-        erase_button(button);
-        button->state = HILITE;
-        if ( button->frames[button->state] ) {
-            button->frame = button->frames[button->state];
-        }
-        draw_button(button);
+        change_button(button, HILITE, button->frames[HILITE] ?
+                                      button->frames[HILITE] : button->frame);
     }
     hilited_button = button;
 }
@@ -409,12 +668,8 @@ static void select_button(struct button *button)
             reset_button(hilited_button);
             hilited_button = button;
         }
-        erase_button(button);
-        button->state = CLICKED;
-        if ( button->frames[button->state] ) {
-            button->frame = button->frames[button->state];
-        }
-        draw_button(button);
+        change_button(button, CLICKED, button->frames[CLICKED] ?
+                                       button->frames[CLICKED] : button->frame);
     }
 }
 
@@ -433,21 +688,29 @@ static void load_images(void)
         for ( state=0; state<NUM_STATES; ++state ) {
             if ( images[i].files[state] ) {
                 get_menu_path(images[i].files[state], path, sizeof(path));
-                images[i].frames[state] = IMG_Load(path);
-                if ( ! images[i].frames[state] && (i != EMPTY) ) {
-                    fprintf(stderr, "Warning: couldn't load %s\n",
-                            images[i].files[state]);
-                }
+                decode_pool_submit(path, &images[i].frames[state]);
             } else {
                 images[i].frames[state] = NULL;
             }
-            images[i].frame = images[i].frames[0];
         }
     }
+    decode_pool_wait();
+
+    for ( i=0; i<(sizeof images)/(sizeof images[0]); ++i ) {
+        for ( state=0; state<NUM_STATES; ++state ) {
+            if ( images[i].files[state] &&
+                 ! images[i].frames[state] && (i != EMPTY) ) {
+                fprintf(stderr, "Warning: couldn't load %s\n",
+                        images[i].files[state]);
+            }
+        }
+        images[i].frame = images[i].frames[0];
+    }
     /* Special case for the update button - disable it if we can't update */
     if ( access("demos", W_OK) != 0 ) {
         images[UPDATE].state = HIDDEN;
     }
+    hit_index_stale = 1;
 }
 
 static void free_images(void)
@@ -470,96 +733,243 @@ static void free_images(void)
                 SDL_DestroySurface(frame);
             }
         }
+        uncompose_button(&images[i]);
     }
+    hit_index_stale = 1;
 }
 
-static void draw_ui(void)
+/* Put the icon and caption of a demo where the panel is scrolled to */
+static void place_demo(struct demo *demo)
+{
+    int x, y;
+
+    x = DEMO_PANEL_X + demo->col * DEMO_PANEL_XSPACE;
+    y = DEMO_PANEL_Y + demo->row * DEMO_PANEL_YSPACE - scroll_y;
+    set_button_xy(&demo->icon, x, y);
+    if ( demo->icon.frame && demo->caption.frame ) {
+        set_button_xy(&demo->caption,
+            x+(demo->icon.frame->w/2)-(demo->caption.frame->w/2) + 4,
+            y+demo->icon.frame->h + 4);
+    }
+}
+
+/* Start loading the icon and caption for a demo coming into view */
+static void load_icons(struct demo *demo)
+{
+    char path[PATH_MAX];
+    char icon_normal[PATH_MAX];
+    char icon_hilite[PATH_MAX];
+
+    /* Load the game icon */
+    sprintf(icon_normal, "demos/%s/launch/box_off.png", demo->name);
+    sprintf(icon_hilite, "demos/%s/launch/box_on.png", demo->name);
+    load_button(&demo->icon, icon_normal,
+                (demo->assets & ASSET_ICON_HILITE) ? icon_hilite : NULL,
+                NULL, NORMAL);
+    demo->icon.clip = &demo_panel;
+
+    /* Load the icon caption */
+    sprintf(path, "demos/%s/launch/caption.png", demo->name);
+    load_button(&demo->caption, path, NULL, NULL, HIDDEN);
+    demo->caption.clip = &demo_panel;
+
+    demo->icons = LOADING;
+}
+
+/* Pick up the icons for any demos that have finished loading */
+static void finish_icons(void)
 {
     int i;
-    struct demo *list;
+    struct demo *demo;
 
-    for ( i=0; i<DEMOS; ++i ) {
-        draw_button(&images[i]);
+    if ( decode_pool_pending() > 0 ) {
+        return;
     }
-    for ( list=demos; list; list=list->next ) {
-        draw_button(&list->icon);
+    for ( i=window_first; i<window_last; ++i ) {
+        demo = &demos[i];
+        if ( demo->icons == LOADING ) {
+            /* Bring back the hilite if it was lost while scrolling */
+            if ( (demo == hilited_demo) || (demo == current_demo) ) {
+                demo->icon.state = HILITE;
+            }
+            if ( demo == hilited_demo ) {
+                demo->caption.state = NORMAL;
+            }
+            finish_button(&demo->icon);
+            finish_button(&demo->caption);
+            if ( ! demo->icon.frame ) {
+                fprintf(stderr, "Couldn't load icon for %s\n", demo->name);
+            }
+            demo->icons = LOADED;
+            place_demo(demo);
+            hit_index_stale = 1;
+            draw_button(&demo->icon);
+            draw_button(&demo->caption);
+        }
     }
-    if ( current_demo ) {
-        draw_button(&current_demo->icon);
-        draw_button(&current_demo->box);
-        draw_button(&current_demo->caption);
-        draw_button(&current_demo->text);
-        draw_button(&current_demo->extra);
+}
+
+/* Free the icon and caption for a demo that has gone out of view */
+static void unload_icons(struct demo *demo)
+{
+    if ( demo->icons == LOADING ) {
+        decode_pool_wait();
+        finish_icons();
     }
-    show_dirty_rects();
+    free_button(&demo->icon);
+    free_button(&demo->caption);
+    memset(&demo->icon, 0, sizeof(demo->icon));
+    memset(&demo->caption, 0, sizeof(demo->caption));
+    demo->caption.state = HIDDEN;
+    demo->icons = UNLOADED;
 }
 
-static char *read_line(const char *file)
+/* Load the icons for the rows in view plus a margin, and unload the rest,
+   so the memory used doesn't depend on how many demos are installed.
+ */
+static void update_icon_window(void)
 {
-    FILE *fp;
-    char line[1024];
-    char *first_line;
+    int first, last, num_rows, i;
+
+    num_rows = (num_demos + MAX_PER_ROW - 1) / MAX_PER_ROW;
+    first = scroll_y / DEMO_PANEL_YSPACE - PREFETCH_ROWS;
+    if ( first < 0 ) {
+        first = 0;
+    }
+    last = (scroll_y + demo_panel.h - 1) / DEMO_PANEL_YSPACE + PREFETCH_ROWS;
+    if ( last >= num_rows ) {
+        last = num_rows - 1;
+    }
+    first *= MAX_PER_ROW;
+    last = (last + 1) * MAX_PER_ROW;
+    if ( last > num_demos ) {
+        last = num_demos;
+    }
 
-    first_line = NULL;
-    fp = fopen(file, "r");
-    if ( fp ) {
-        if ( fgets(line, sizeof(line), fp) ) {
-            line[strlen(line)-1] = '\0';
-            first_line = strdup(line);
+    for ( i=window_first; i<window_last; ++i ) {
+        if ( ((i < first) || (i >= last)) && (demos[i].icons != UNLOADED) ) {
+            unload_icons(&demos[i]);
+        }
+    }
+    for ( i=first; i<last; ++i ) {
+        if ( demos[i].icons == UNLOADED ) {
+            load_icons(&demos[i]);
+        } else {
+            place_demo(&demos[i]);
         }
-        fclose(fp);
     }
-    return(first_line);
+    window_first = first;
+    window_last = last;
+    hit_index_stale = 1;
 }
 
-static void save_last_demo(const char *last_demo)
+/* Draw the icons that are scrolled into view */
+static void draw_demos(void)
 {
-    FILE *fp;
-    char path[PATH_MAX];
+    int i;
 
-    sprintf(path, "%s/.loki", getenv("HOME"));
-    mkdir(path, 0700);
-    strcat(path, "/loki_demos");
-    mkdir(path, 0700);
-    strcat(path, "/last_demo.txt");
-    fp = fopen(path, "w");
-    if ( fp ) {
-        fprintf(fp, "%s\n", last_demo);
-        fclose(fp);
+    for ( i=window_first; i<window_last; ++i ) {
+        draw_button(&demos[i].icon);
+    }
+    if ( hilited_demo ) {
+        draw_button(&hilited_demo->caption);
     }
 }
 
-static char *get_last_demo(char *last_demo_buf, int maxlen)
+static int max_scroll(void)
 {
-    char *last_demo;
-    FILE *fp;
-    char path[PATH_MAX];
+    int num_rows;
 
-    last_demo = NULL;
-    sprintf(path, "%s/.loki/loki_demos/last_demo.txt", getenv("HOME"));
-    fp = fopen(path, "r");
-    if ( fp ) {
-        if ( fgets(path, sizeof(path), fp) ) {
-            path[strlen(path)-1] = '\0';
-            strncpy(last_demo_buf, path, maxlen);
-            last_demo = last_demo_buf;
-        }
-        fclose(fp);
+    num_rows = (num_demos + MAX_PER_ROW - 1) / MAX_PER_ROW;
+    if ( num_rows <= VISIBLE_ROWS ) {
+        return(0);
     }
-    return(last_demo);
+    return((num_rows - VISIBLE_ROWS) * DEMO_PANEL_YSPACE);
 }
 
-static void free_demo(struct demo *demo)
+/* Start scrolling the demo panel by a number of rows */
+static void scroll_demos(int rows)
+{
+    scroll_target += rows * DEMO_PANEL_YSPACE;
+    if ( scroll_target > max_scroll() ) {
+        scroll_target = max_scroll();
+    }
+    if ( scroll_target < 0 ) {
+        scroll_target = 0;
+    }
+    state_set_scroll(scroll_target);
+}
+
+/* Start scrolling the demo panel just far enough to show a demo */
+static void reveal_demo(struct demo *demo)
+{
+    int y;
+
+    y = demo->row * DEMO_PANEL_YSPACE;
+    if ( y < scroll_target ) {
+        scroll_target = y;
+    }
+    y += DEMO_PANEL_YSPACE - demo_panel.h;
+    if ( y > scroll_target ) {
+        scroll_target = y;
+    }
+    state_set_scroll(scroll_target);
+}
+
+/* Jump straight to a demo, loading the icons around it */
+static void scroll_to_demo(struct demo *demo)
 {
-    if ( demo->name ) {
-        free(demo->name);
+    reveal_demo(demo);
+    scroll_y = scroll_target;
+    update_icon_window();
+    decode_pool_wait();
+    finish_icons();
+}
+
+/* Move the demo panel a step closer to where it is being scrolled */
+static void update_scroll(void)
+{
+    int step;
+
+    if ( (scroll_y == scroll_target) || (SDL_GetTicks() < scroll_time) ) {
+        return;
     }
-    if ( demo->trailer ) {
-        free(demo->trailer);
+    scroll_time = SDL_GetTicks() + SCROLL_DELAY;
+    step = (scroll_target - scroll_y) / 3;
+    if ( step == 0 ) {
+        step = (scroll_target > scroll_y) ? 1 : -1;
+    }
+    scroll_y += step;
+    update_icon_window();
+
+    /* Repaint the whole panel, the icons were all moved */
+    SDL_BlitSurface(images[BACKGROUND].frame, &demo_panel, screen, &demo_panel);
+    add_dirty_rect(&demo_panel);
+    draw_demos();
+}
+
+static void draw_ui(void)
+{
+    int i;
+
+    for ( i=0; i<DEMOS; ++i ) {
+        draw_button(&images[i]);
     }
-    if ( demo->website ) {
-        free(demo->website);
+    draw_demos();
+    if ( current_demo ) {
+        draw_button(&current_demo->box);
+        draw_button(&current_demo->caption);
+        draw_button(&current_demo->text);
+        draw_button(&current_demo->extra);
     }
+    TRACE_BEGIN("show_dirty_rects", NULL);
+    show_dirty_rects();
+    TRACE_END("show_dirty_rects");
+}
+
+/* The name, trailer and website belong to the catalog */
+static void free_demo(struct demo *demo)
+{
     free_button(&demo->box);
     free_button(&demo->icon);
     free_button(&demo->caption);
@@ -567,89 +977,203 @@ static void free_demo(struct demo *demo)
     free_button(&demo->extra);
 }
 
-static void load_demo(const char *demo_name)
+/* See if a demo is missing the artwork it needs to be shown on the menu.
+   This returns the missing artwork, or NULL if the demo can be shown.
+ */
+static const char *missing_artwork(const struct catalog_entry *entry)
 {
-    struct demo *demo, *prev, *list;
-    char path[PATH_MAX];
-    char icon_normal[PATH_MAX];
-    char icon_hilite[PATH_MAX];
+    if ( ! (entry->assets & ASSET_ICON) ) {
+        return("icon");
+    }
+    if ( ! (entry->assets & ASSET_CAPTION) ) {
+        return("caption");
+    }
+    return(NULL);
+}
 
-    demo = (struct demo *)malloc(sizeof *demo);
-    if ( demo ) {
-        memset(demo, 0, (sizeof *demo));
+static int load_demo(struct demo *demo, struct catalog_entry *entry)
+{
+    const char *missing;
+
+    /* The catalog has already found the trailer and homepage */
+    demo->name = entry->name;
+    demo->trailer = entry->trailer;
+    demo->website = entry->website;
+    demo->assets = entry->assets;
+    missing = missing_artwork(entry);
+    if ( missing ) {
+        fprintf(stderr, "Couldn't load %s for %s\n", missing, demo->name);
+        return(0);
+    }
 
-        /* Copy the name of the demo for alphabetizing */
-        demo->name = strdup(demo_name);
-        if ( ! demo->name ) {
-            /* Uh oh.. */
-            fprintf(stderr, "Out of memory\n");
-            free_demo(demo);
-            return;
-        }
+    /* All of the artwork is loaded when first needed */
+    demo->icons = UNLOADED;
+    demo->caption.state = HIDDEN;
+    demo->panels = UNLOADED;
+    demo->box.state = HIDDEN;
+    demo->text.state = HIDDEN;
+    demo->extra.state = HIDDEN;
+    return(1);
+}
 
-        /* Load the trailer for this game */
-        sprintf(path, "demos/%s/trailer.mpg", demo_name);
-        if ( access(path, R_OK) == 0 ) {
-            demo->trailer = strdup(path);
-        } else {
-            demo->trailer = NULL;
-        }
+static int compare_demo(const void *key, const void *elem)
+{
+    return(strcasecmp((const char *)key, ((const struct demo *)elem)->name));
+}
 
-        /* Load the homepage for the game */
-        sprintf(path, "demos/%s/launch/website.txt", demo_name);
-        demo->website = read_line(path);
-
-        /* Load the game icon */
-        sprintf(icon_normal, "demos/%s/launch/box_off.png", demo_name);
-        sprintf(icon_hilite, "demos/%s/launch/box_on.png", demo_name);
-        load_button(&demo->icon, icon_normal, icon_hilite, NULL, NORMAL);
-        if ( ! demo->icon.frame ) {
-            fprintf(stderr, "Couldn't load icon for %s\n", demo_name);
-            free_demo(demo);
-            return;
-        }
+/* Find a demo by name, ignoring case */
+static struct demo *find_demo(const char *name)
+{
+    return((struct demo *)bsearch(name, demos, num_demos,
+                                  sizeof(*demos), compare_demo));
+}
+
+/* Free the box, text and extra artwork for a demo that isn't shown */
+static void unload_panels(struct demo *demo)
+{
+    free_button(&demo->box);
+    free_button(&demo->text);
+    free_button(&demo->extra);
+    memset(&demo->box, 0, sizeof(demo->box));
+    memset(&demo->text, 0, sizeof(demo->text));
+    memset(&demo->extra, 0, sizeof(demo->extra));
+    demo->box.state = HIDDEN;
+    demo->text.state = HIDDEN;
+    demo->extra.state = HIDDEN;
+    demo->panels = UNLOADED;
+}
+
+/* Pick up the artwork for any demos that have finished loading */
+static void finish_panels(void)
+{
+    int i;
+    struct demo *demo;
 
-        /* Load the icon caption */
-        sprintf(path, "demos/%s/launch/caption.png", demo_name);
-        load_button(&demo->caption, path, NULL, NULL, HIDDEN);
-        if ( ! demo->caption.frame ) {
-            fprintf(stderr, "Couldn't load caption for %s\n", demo_name);
-            free_demo(demo);
-            return;
+    if ( decode_pool_pending() > 0 ) {
+        return;
+    }
+    for ( i=0; i<MAX_CACHED_PANELS; ++i ) {
+        demo = recent_panels[i];
+        if ( demo && (demo->panels == LOADING) ) {
+            finish_button(&demo->box);
+            finish_button(&demo->text);
+            finish_button(&demo->extra);
+            demo->panels = LOADED;
         }
+    }
+}
+
+/* Move a demo to the front of the recently viewed list, making room by
+   unloading the artwork of the least recently viewed demo.
+ */
+static void remember_panels(struct demo *demo)
+{
+    int i, slot;
 
-        /* Load the game box */
-        sprintf(path, "demos/%s/launch/box.png", demo_name);
-        load_button(&demo->box, path, NULL, NULL, HIDDEN);
-        set_button_xy(&demo->box, 64, 250);
-
-        /* Load the text for the game
-           FIXME: Add internationalization support?
-        */
-        sprintf(path, "demos/%s/launch/text.png", demo_name);
-        load_button(&demo->text, path, NULL, NULL, HIDDEN);
-        set_button_xy(&demo->text, 204, 244);
-
-        /* Load the extra informational icon */
-        sprintf(path, "demos/%s/launch/extra.png", demo_name);
-        load_button(&demo->extra, path, NULL, NULL, HIDDEN);
-        set_button_xy(&demo->extra, 514, 244);
-
-        /* Add the demo to our list */
-        prev = NULL;
-        for ( list=demos; list; list = list->next ) {
-            /* Search for the alphabetical match */
-            if ( strcasecmp(demo->name, list->name) <= 0 ) {
+    for ( slot=0; slot<MAX_CACHED_PANELS-1; ++slot ) {
+        if ( recent_panels[slot] == demo ) {
+            break;
+        }
+    }
+    if ( recent_panels[slot] && (recent_panels[slot] != demo) ) {
+        /* The list is full, find a demo we can throw out */
+        for ( slot=MAX_CACHED_PANELS-1; slot>0; --slot ) {
+            if ( (recent_panels[slot] != current_demo) &&
+                 (recent_panels[slot]->panels != LOADING) ) {
                 break;
             }
-            prev = list;
         }
-        demo->next = list;
-        if ( prev ) {
-            prev->next = demo;
-        } else {
-            demos = demo;
+        if ( slot == 0 ) {
+            /* Everything is busy, wait for the loads to finish */
+            decode_pool_wait();
+            finish_panels();
+            slot = MAX_CACHED_PANELS-1;
+            if ( recent_panels[slot] == current_demo ) {
+                --slot;
+            }
+        }
+        unload_panels(recent_panels[slot]);
+    }
+    for ( i=slot; i>0; --i ) {
+        recent_panels[i] = recent_panels[i-1];
+    }
+    recent_panels[0] = demo;
+}
+
+/* Start loading the box, text and extra artwork for a demo */
+static void prefetch_panels(struct demo *demo)
+{
+    char path[PATH_MAX];
+
+    remember_panels(demo);
+    if ( demo->panels != UNLOADED ) {
+        return;
+    }
+
+    /* Load the game box */
+    sprintf(path, "demos/%s/launch/box.png", demo->name);
+    load_button(&demo->box, (demo->assets & ASSET_BOX) ? path : NULL,
+                NULL, NULL, HIDDEN);
+    set_button_xy(&demo->box, 64, 250);
+
+    /* Load the text for the game
+       FIXME: Add internationalization support?
+    */
+    sprintf(path, "demos/%s/launch/text.png", demo->name);
+    load_button(&demo->text, (demo->assets & ASSET_TEXT) ? path : NULL,
+                NULL, NULL, HIDDEN);
+    set_button_xy(&demo->text, 204, 244);
+
+    /* Load the extra informational icon */
+    sprintf(path, "demos/%s/launch/extra.png", demo->name);
+    load_button(&demo->extra, (demo->assets & ASSET_EXTRA) ? path : NULL,
+                NULL, NULL, HIDDEN);
+    set_button_xy(&demo->extra, 514, 244);
+
+    demo->panels = LOADING;
+}
+
+/* Make sure the box, text and extra artwork for a demo are ready.
+   Icons queued while scrolling are left to finish in the background.
+ */
+static void load_panels(struct demo *demo)
+{
+    prefetch_panels(demo);
+    if ( demo->panels == LOADING ) {
+        wait_button(&demo->box);
+        wait_button(&demo->text);
+        wait_button(&demo->extra);
+        finish_button(&demo->box);
+        finish_button(&demo->text);
+        finish_button(&demo->extra);
+        demo->panels = LOADED;
+    }
+}
+
+/* Start reading the program and data files for a demo that is likely
+   to be launched soon
+ */
+static void readahead_demo(struct demo *demo)
+{
+    char command[PATH_MAX*2];
+    char profile[PATH_MAX];
+
+    if ( catalog_launch_command(demo->name, command, sizeof(command)) == 0 ) {
+        access_profile_path(demo->name, profile, sizeof(profile));
+        readahead_start(command, profile);
+    }
+}
+
+/* Load the artwork for the demo under the mouse if it stays there */
+static void check_prefetch(void)
+{
+    finish_panels();
+    if ( prefetch_demo && (SDL_GetTicks() >= prefetch_time) ) {
+        if ( prefetch_demo->panels == UNLOADED ) {
+            prefetch_panels(prefetch_demo);
         }
+        readahead_demo(prefetch_demo);
+        prefetch_demo = NULL;
     }
 }
 
@@ -661,6 +1185,8 @@ static void hilite_demo(struct demo *demo)
     if ( demo != hilited_demo ) {
         previous_demo = hilited_demo;
         hilited_demo = demo;
+        prefetch_demo = NULL;
+        readahead_cancel();
         if ( previous_demo ) {
             reset_button(&previous_demo->icon);
             hide_button(&previous_demo->caption);
@@ -670,6 +1196,8 @@ static void hilite_demo(struct demo *demo)
         if ( hilited_demo ) {
             hilite_button(&hilited_demo->icon);
             show_button(&hilited_demo->caption);
+            prefetch_demo = hilited_demo;
+            prefetch_time = SDL_GetTicks() + PREFETCH_DELAY;
         }
     }
 }
@@ -694,6 +1222,9 @@ static void activate_demo(struct demo *demo)
     /* Show the current demo */
     if ( current_demo ) {
         hilite_demo(current_demo);
+        load_panels(current_demo);
+        prefetch_demo = NULL;
+        readahead_demo(current_demo);
         show_button(&current_demo->box);
         show_button(&current_demo->text);
         show_button(&current_demo->extra);
@@ -706,71 +1237,224 @@ static void activate_demo(struct demo *demo)
             show_button(&images[PLAY]);
             show_button(&images[OPTIONS]);
         }
-        save_last_demo(current_demo->name);
+        state_set_last_demo(current_demo->name);
     }
 }
 
 static void load_demos(void)
 {
     struct demo *demo;
-    DIR *dir;
-    struct dirent *entry;
-
-    /* Scan the demos directory for demos that have artwork */
-    dir = opendir("demos");
-    if ( dir ) {
-        while ( (entry=readdir(dir)) != NULL ) {
-            if ( entry->d_name[0] != '.' ) {
-                load_demo(entry->d_name);
-            }
-        }
-        closedir(dir);
-    }
-    /* Arrange them all on the screen */
+    struct catalog_entry *entries;
+    int i, count;
+
+    /* Go through the catalog, which is already sorted by name */
+    TRACE_BEGIN("catalog_load", NULL);
+    count = catalog_load(&entries);
+    TRACE_END("catalog_load");
     num_demos = 0;
-    for ( demo = demos; demo; demo = demo->next ) {
-        demo->row = num_demos/MAX_PER_ROW;
-        demo->col = num_demos%MAX_PER_ROW;
-        set_button_xy(&demo->icon,
-                      DEMO_PANEL_X + demo->col * DEMO_PANEL_XSPACE,
-                      DEMO_PANEL_Y + demo->row * DEMO_PANEL_YSPACE);
-        set_button_xy(&demo->caption,
-            demo->icon.x+(demo->icon.frame->w/2)-(demo->caption.frame->w/2) + 4,
-            demo->icon.y+demo->icon.frame->h + 4);
-        ++num_demos;
+    if ( count > 0 ) {
+        demos = (struct demo *)calloc(count, sizeof(*demos));
+        if ( ! demos ) {
+            fprintf(stderr, "Out of memory\n");
+            count = 0;
+        }
     }
-    if ( num_demos == 0 ) {
-        images[EMPTY].state = NORMAL;
+    /* Drop the demos that don't have any artwork */
+    for ( i=0; i<count; ++i ) {
+        demo = &demos[num_demos];
+        if ( load_demo(demo, &entries[i]) ) {
+            /* Arrange them all on the panel, which scrolls */
+            demo->row = num_demos/MAX_PER_ROW;
+            demo->col = num_demos%MAX_PER_ROW;
+            ++num_demos;
+        }
     }
+    scroll_y = 0;
+    scroll_target = 0;
+    window_first = 0;
+    window_last = 0;
+    hit_index_stale = 1;
+    images[EMPTY].state = (num_demos == 0) ? NORMAL : HIDDEN;
 }
 
-static void free_demos(void)
+static void print_json_string(const char *str)
 {
-    struct demo *freeable;
-
-    while ( demos ) {
-        freeable = demos;
-        free_demo(freeable);
-        demos = demos->next;
+    if ( ! str ) {
+        printf("null");
+        return;
     }
-    current_demo = NULL;
-    hilited_demo = NULL;
+    putchar('"');
+    for ( ; *str; ++str ) {
+        if ( (*str == '"') || (*str == '\\') ) {
+            printf("\\%c", *str);
+        } else if ( (unsigned char)*str < ' ' ) {
+            printf("\\u%04x", (unsigned char)*str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
 }
 
-static int init_ui(int use_sound)
+/* Print the installed demos without starting the UI, one per line.
+   Plain output is the names of the demos on the menu, and JSON output
+   has an object for every demo in the catalog.
+ */
+static int list_demos(int json)
+{
+    struct catalog_entry *entries;
+    char command[PATH_MAX*2];
+    char path[PATH_MAX];
+    const char *missing;
+    int i, count, launchable;
+
+    count = catalog_load(&entries);
+    for ( i=0; i<count; ++i ) {
+        missing = missing_artwork(&entries[i]);
+        if ( ! json ) {
+            if ( ! missing ) {
+                printf("%s\n", entries[i].name);
+            }
+            continue;
+        }
+        launchable = (catalog_launch_command(entries[i].name, command,
+                                             sizeof(command)) == 0);
+        snprintf(path, sizeof(path), "%s/.loki/loki_demos/%s/launch.txt",
+                 getenv("HOME"), entries[i].name);
+        printf("{\"name\":");
+        print_json_string(entries[i].name);
+        printf(",\"shown\":%s,\"missing\":", missing ? "false" : "true");
+        print_json_string(missing);
+        printf(",\"trailer\":");
+        print_json_string(entries[i].trailer);
+        printf(",\"website\":");
+        print_json_string(entries[i].website);
+        printf(",\"launch\":");
+        print_json_string(launchable ? command : NULL);
+        printf(",\"user_launch\":%s}\n",
+               (access(path, R_OK) == 0) ? "true" : "false");
+    }
+    catalog_free();
+    return(count < 0);
+}
+
+static void free_demos(void)
+{
+    int i;
+
+    /* Make sure nothing is still being loaded into the demos */
+    decode_pool_wait();
+    memset(recent_panels, 0, sizeof(recent_panels));
+    prefetch_demo = NULL;
+
+    for ( i=0; i<num_demos; ++i ) {
+        free_demo(&demos[i]);
+    }
+    free(demos);
+    demos = NULL;
+    num_demos = 0;
+    window_first = 0;
+    window_last = 0;
+    hit_index_stale = 1;
+    catalog_free();
+    current_demo = NULL;
+    hilited_demo = NULL;
+}
+
+/* Open the audio device and load the click sound */
+static void open_audio(int use_sound)
+{
+    if ( use_sound ) {
+        TRACE_BEGIN("MIX_Init", NULL);
+        MIX_Init();
+        mixer = MIX_CreateMixerDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, NULL);
+        track = MIX_CreateTrack(mixer);
+        TRACE_END("MIX_Init");
+
+        TRACE_BEGIN("load_sounds", NULL);
+        load_sounds();
+        TRACE_END("load_sounds");
+    }
+}
+
+/* Close the audio device so the demos can use it */
+static void close_audio(void)
+{
+    free_sounds();
+    MIX_DestroyTrack(track);
+    track = NULL;
+    MIX_DestroyMixer(mixer);
+    mixer = NULL;
+}
+
+/* Remember when the artwork directories were last changed */
+static void get_ui_stamp(time_t stamp[2])
+{
+    struct stat sb;
+    char path[128];
+
+    stamp[0] = (stat("demos", &sb) == 0) ? sb.st_mtime : 0;
+    get_menu_path("", path, sizeof(path));
+    stamp[1] = (stat(path, &sb) == 0) ? sb.st_mtime : 0;
+}
+static time_t ui_stamp[2];
+
+/* Load all of the artwork and show the last demo that was launched */
+static void load_ui(void)
+{
+    struct demo *demo;
+    const char *last_demo;
+
+    /* Load everything */
+    get_ui_stamp(ui_stamp);
+    TRACE_BEGIN("load_images", NULL);
+    load_images();
+    TRACE_END("load_images");
+    TRACE_BEGIN("load_demos", NULL);
+    load_demos();
+    TRACE_END("load_demos");
+
+    /* Find the last demo that was launched, and load the icons around it */
+    demo = NULL;
+    last_demo = state_last_demo();
+    if ( last_demo ) {
+        demo = find_demo(last_demo);
+    }
+    if ( ! demo ) {
+        demo = demos;
+    }
+    scroll_target = state_scroll();
+    scroll_demos(0);
+    if ( demo ) {
+        TRACE_BEGIN("load_icons", NULL);
+        scroll_to_demo(demo);
+        TRACE_END("load_icons");
+    }
+    surface_cache_trim();
+
+    /* Start up the UI, and we're done! */
+    TRACE_BEGIN("draw_ui", NULL);
+    draw_ui();
+    TRACE_END("draw_ui");
+
+    /* Select the last demo that was launched */
+    activate_demo(demo);
+}
+
+static int init_ui(int use_sound)
 {
-    struct demo *demo;
-    char last_demo_buf[128];
-    char *last_demo;
-
     if ( ! window ) {
         /* Initialize SDL */
+        TRACE_BEGIN("SDL_Init", NULL);
         if ( SDL_Init(SDL_INIT_AUDIO|SDL_INIT_VIDEO) != true ) {
             fprintf(stderr, "Couldn't init SDL: %s\n", SDL_GetError());
             return(-1);
         }
+        TRACE_END("SDL_Init");
 
+        TRACE_BEGIN("SDL_CreateWindow", NULL);
         window = SDL_CreateWindow("Loki Demo Launcher", 640, 480, 0);
+        TRACE_END("SDL_CreateWindow");
         if ( ! window ) {
             fprintf(stderr, "Couldn't create SDL_Window: %s\n", SDL_GetError());
             SDL_Quit();
@@ -778,43 +1462,78 @@ static int init_ui(int use_sound)
         }
         SDL_SetWindowIcon(window, SDL_LoadBMP("icon.bmp"));
         screen = SDL_GetWindowSurface(window);
+        damage_reset(screen->w, screen->h);
+
+        /* Wake up the main loop when the artwork has been decoded */
+        decode_event = SDL_RegisterEvents(1);
+        decode_pool_notify(decode_event);
+
+        /* ... and when a demo exits */
+        child_event = SDL_RegisterEvents(1);
+        if ( child_proc_init(child_event) < 0 ) {
+            child_poll = 500;
+        }
+
+        /* ... and when the menu is started again */
+        instance_event = SDL_RegisterEvents(1);
+        instance_listen(instance_event);
+
+        /* Use the prepacked artwork if it was built for this window,
+           and convert everything else for it
+         */
+        artpack_open(ARTPACK_FILE, SDL_GetWindowPixelFormat(window));
+        surface_cache_format(SDL_GetWindowPixelFormat(window));
+        surface_prep_format(SDL_GetWindowPixelFormat(window));
     }
 
     /* Open the audio */
-    if ( use_sound ) {
-        MIX_Init();
-        mixer = MIX_CreateMixerDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, NULL);
-        track = MIX_CreateTrack(mixer);
-    }
+    open_audio(use_sound);
 
     /* Load everything */
-    if ( use_sound ) {
-        load_sounds();
-    }
-    load_images();
-    load_demos();
+    load_ui();
 
-    /* Start up the UI, and we're done! */
-    draw_ui();
+    return(0);
+}
 
-    /* Select the last demo that was launched */
-    demo = NULL;
-    last_demo = get_last_demo(last_demo_buf, sizeof(last_demo_buf));
-    if ( last_demo ) {
-        demo = demos;
-        while ( demo ) {
-            if ( strcasecmp(last_demo, demo->name) == 0 ) {
-                break;
-            }
-            demo = demo->next;
+/* Release the audio device for a demo, keeping the decoded artwork */
+static void suspend_ui(void)
+{
+    close_audio();
+}
+
+/* Bring the menu back after a demo exits */
+static void resume_ui(int use_sound)
+{
+    time_t stamp[2];
+    int i;
+
+    /* The demo may have changed the video mode */
+    screen = SDL_GetWindowSurface(window);
+    damage_reset(screen->w, screen->h);
+    open_audio(use_sound);
+
+    /* Put the buttons back the way they were before the click */
+    hilite_demo(current_demo);
+    for ( i=0; i<DEMOS; ++i ) {
+        if ( images[i].state > NORMAL ) {
+            images[i].state = NORMAL;
+            images[i].frame = images[i].frames[NORMAL];
         }
     }
-    if ( ! demo ) {
-        demo = demos;
+    hilited_button = NULL;
+    images[UPDATE].state = (access("demos", W_OK) == 0) ? NORMAL : HIDDEN;
+
+    /* If demos were installed or removed meanwhile, start from scratch */
+    get_ui_stamp(stamp);
+    if ( (stamp[0] != ui_stamp[0]) || (stamp[1] != ui_stamp[1]) ) {
+        free_demos();
+        free_images();
+        load_ui();
+        return;
     }
-    activate_demo(demo);
 
-    return(0);
+    /* Otherwise the menu can be repainted right away */
+    draw_ui();
 }
 
 static void quit_ui(void)
@@ -822,18 +1541,16 @@ static void quit_ui(void)
     /* Free memory we've allocated */
     free_demos();
     free_images();
-    free_sounds();
 
     /* Free system resources */
-    MIX_DestroyTrack(track);
-    MIX_DestroyMixer(mixer);
+    close_audio();
 }
 
 static int in_button(struct button *button, int x, int y)
 {
     int is_in_area = 0;
 
-    if ( button->sensitive && (button->state != HIDDEN) ) {
+    if ( button->sensitive && (button->state != HIDDEN) && button->frame ) {
         int area_x = button->x;
         int area_y = button->y;
         int area_w = button->frame->w;
@@ -841,37 +1558,153 @@ static int in_button(struct button *button, int x, int y)
 
         is_in_area = ((x >= area_x) && (y >= area_y) &&
                       (x <= (area_x+area_w)) && (y <= (area_y+area_h)));
+        if ( button->clip ) {
+            is_in_area = is_in_area &&
+                ((x >= button->clip->x) && (y >= button->clip->y) &&
+                 (x < (button->clip->x+button->clip->w)) &&
+                 (y < (button->clip->y+button->clip->h)));
+        }
     }
     return(is_in_area);
 }
 
 static int in_demo_panel(int x, int y)
 {
-    int row, n = num_demos;
+    int row, col;
 
-    /* If it's outside the top left edge, it's not in the demo panel */
-    if ( (x < DEMO_PANEL_X) || (y < DEMO_PANEL_Y) ) {
+    /* If it's outside the visible part, it's not in the demo panel */
+    if ( (x < demo_panel.x) || (y < demo_panel.y) ||
+         (x >= (demo_panel.x + demo_panel.w)) ||
+         (y >= (demo_panel.y + demo_panel.h)) ) {
         return(0);
     }
-    /* If it's outside the bottom edge, it's not in the demo panel */
-    if ( y > (DEMO_PANEL_Y + ((n/MAX_PER_ROW)+1)*DEMO_PANEL_YSPACE) ) {
-        return(0);
+    /* If there's a demo at this spot in the scrolled grid, it's in the panel */
+    row = (y - demo_panel.y + scroll_y)/DEMO_PANEL_YSPACE;
+    col = (x - demo_panel.x)/DEMO_PANEL_XSPACE;
+    if ( (row*MAX_PER_ROW + col) < num_demos ) {
+        return(1);
     }
-    /* If it's inside the right edge for this row, it's in the demo panel */
-    row = (y - DEMO_PANEL_Y)/DEMO_PANEL_YSPACE;
-    if ( n > MAX_PER_ROW ) {
-        if ( row == 0 ) {
-            if ( x < (DEMO_PANEL_X + MAX_PER_ROW*DEMO_PANEL_XSPACE) ) {
-                return(1);
+    return(0);
+}
+
+/* Add a button to the cells of the hit index that it covers */
+static void index_button(struct button *button, struct demo *demo)
+{
+    SDL_Rect area;
+    struct hit_cell *cell;
+    int i, w, h, row, col;
+
+    /* Cover every frame, the state may change before the next rebuild */
+    w = 0;
+    h = 0;
+    for ( i=0; i<NUM_STATES; ++i ) {
+        if ( button->frames[i] ) {
+            if ( button->frames[i]->w > w ) {
+                w = button->frames[i]->w;
+            }
+            if ( button->frames[i]->h > h ) {
+                h = button->frames[i]->h;
             }
-            return(0);
         }
-        n -= MAX_PER_ROW;
     }
-    if ( x < (DEMO_PANEL_X + n*DEMO_PANEL_XSPACE) ) {
-        return(1);
+    if ( ! button->sensitive || ! w ) {
+        return;
+    }
+    /* in_button() includes the right and bottom edges */
+    area.x = button->x;
+    area.y = button->y;
+    area.w = w + 1;
+    area.h = h + 1;
+    if ( button->clip &&
+         ! SDL_GetRectIntersection(&area, button->clip, &area) ) {
+        return;
+    }
+
+    for ( row=area.y/HIT_CELL_SIZE;
+          row<=(area.y+area.h-1)/HIT_CELL_SIZE; ++row ) {
+        if ( (row < 0) || (row >= SDL_arraysize(hit_index)) ) {
+            continue;
+        }
+        for ( col=area.x/HIT_CELL_SIZE;
+              col<=(area.x+area.w-1)/HIT_CELL_SIZE; ++col ) {
+            if ( (col < 0) || (col >= SDL_arraysize(hit_index[0])) ) {
+                continue;
+            }
+            cell = &hit_index[row][col];
+            if ( cell->count == HIT_CELL_BUTTONS ) {
+                cell->count = -1;
+            }
+            if ( cell->count >= 0 ) {
+                cell->buttons[cell->count] = button;
+                cell->demos[cell->count] = demo;
+                ++cell->count;
+            }
+        }
     }
-    return(0);
+}
+
+/* Sort the buttons on the screen into the cells of the hit index.
+   This only needs to be done when buttons are loaded or move around.
+ */
+static void build_hit_index(void)
+{
+    int i;
+
+    memset(hit_index, 0, sizeof(hit_index));
+    for ( i=0; i<DEMOS; ++i ) {
+        index_button(&images[i], NULL);
+    }
+    for ( i=window_first; i<window_last; ++i ) {
+        index_button(&demos[i].icon, &demos[i]);
+    }
+    hit_index_stale = 0;
+}
+
+/* Find the button under the mouse, and the demo it belongs to, if any.
+   The standard pieces of the interface come before the demo icons.
+ */
+static struct button *find_button(int x, int y, struct demo **demo)
+{
+    struct hit_cell *cell;
+    int i;
+
+    *demo = NULL;
+    if ( (x < 0) || (y < 0) ||
+         (y/HIT_CELL_SIZE >= SDL_arraysize(hit_index)) ||
+         (x/HIT_CELL_SIZE >= SDL_arraysize(hit_index[0])) ) {
+        return(NULL);
+    }
+    if ( hit_index_stale ) {
+        build_hit_index();
+    }
+    cell = &hit_index[y/HIT_CELL_SIZE][x/HIT_CELL_SIZE];
+    if ( cell->count < 0 ) {
+        /* Too crowded to index, check everything that could be here */
+        for ( i=0; i<DEMOS; ++i ) {
+            if ( in_button(&images[i], x, y) ) {
+                return(&images[i]);
+            }
+        }
+        for ( i=window_first; i<window_last; ++i ) {
+            if ( in_button(&demos[i].icon, x, y) ) {
+                *demo = &demos[i];
+                return(&demos[i].icon);
+            }
+        }
+        return(NULL);
+    }
+    for ( i=0; i<cell->count; ++i ) {
+        if ( in_button(cell->buttons[i], x, y) ) {
+            *demo = cell->demos[i];
+            return(cell->buttons[i]);
+        }
+    }
+    return(NULL);
+}
+
+static int is_image(struct button *button)
+{
+    return((button >= images) && (button < images+DEMOS));
 }
 
 static void show_plaque(const char *image)
@@ -889,7 +1722,7 @@ static void show_plaque(const char *image)
 
     /* Show the loading plaque */
     get_menu_path(image, path, sizeof(path));
-    plaque = IMG_Load(path);
+    plaque = load_image(path);
     if ( plaque ) {
         dst.x = (screen->w - plaque->w)/2;
         dst.y = (screen->h - plaque->h)/2;
@@ -901,130 +1734,317 @@ static void show_plaque(const char *image)
     SDL_UpdateWindowSurface(window);
 }
 
-/* A version of system() that keeps the UI active */
-static int system_ui(const char *command)
+/* Hold on to a request from another menu until we're back at the menu */
+static void defer_request(SDL_Event *event)
+{
+    if ( num_deferred < MAX_DEFERRED ) {
+        deferred[num_deferred++] = *event;
+    } else {
+        fprintf(stderr, "Too many requests, dropping %s\n",
+                (char *)event->user.data1);
+        free(event->user.data1);
+    }
+}
+
+static void requeue_requests(void)
+{
+    int i;
+
+    for ( i=0; i<num_deferred; ++i ) {
+        if ( ! SDL_PushEvent(&deferred[i]) ) {
+            free(deferred[i].user.data1);
+        }
+    }
+    num_deferred = 0;
+}
+
+/* Start a command without forking a copy of the whole menu,
+   in the given environment, or ours if it's NULL.
+   What the command prints goes to the named log instead of our terminal.
+   If demo isn't NULL, the command is started under its launch policy.
+ */
+static pid_t spawn_ui(const char *command, char **env, const char *log,
+                      const char *demo)
 {
     pid_t child;
+    int output;
+
+    TRACE_BEGIN("child_proc_spawn", command);
+    child = launch_policy_spawn(demo, command, env, &output);
+    TRACE_END("child_proc_spawn");
+    if ( child > 0 ) {
+        child_proc_watch(child, output, log);
+    }
+    return(child);
+}
+
+/* Wait for a command started by spawn_ui(), keeping the UI active.
+   The resource usage of the command is returned if usage isn't NULL.
+ */
+static int wait_ui(pid_t child, struct rusage *usage)
+{
     int status;
+    int quit;
+    int policy;
+    int reaped;
+    SDL_Event event;
 
-    child = fork();
-    switch(child) {
-        case -1:
-            perror("fork() failed");
-            return(-1);
-        case 0:
-            /* Child */
-            execl("/bin/sh", "sh", "-c", command, NULL);
-            perror("Couldn't exec /bin/sh");
-            _exit(-1);
-        default:
-            /* Parent */
-            break;
+    if ( child < 0 ) {
+        return(-1);
+    }
+
+    /* Keep the window alive until the child process exits.  Input meant
+       for the child is thrown away, but a request to quit is kept.
+       We only wake up for that, at the lowest priority we can switch
+       back from.
+     */
+    quit = 0;
+    policy = launch_policy_idle();
+    while ( (reaped=child_proc_reap(child, &status, usage)) == 0 ) {
+        if ( ! SDL_WaitEventTimeout(&event, child_poll) ) {
+            continue;
+        }
+        switch (event.type) {
+            case SDL_EVENT_WINDOW_EXPOSED:
+                SDL_UpdateWindowSurface(window);
+                break;
+            case SDL_EVENT_QUIT:
+                quit = 1;
+                break;
+            default:
+                /* A demo is already running, other menus have to wait */
+                if ( event.type == instance_event ) {
+                    defer_request(&event);
+                }
+                break;
+        }
+    }
+    launch_policy_resume(policy);
+
+    /* There were too many children for spawn_ui() to watch this one */
+    if ( reaped < 0 ) {
+        wait4(child, &status, 0, usage);
     }
-    /* Wait for the child process to return */
-    while ( waitpid(child, &status, WNOHANG) != child ) {
-        SDL_PumpEvents();
-        SDL_Delay(500);
+    if ( quit ) {
+        SDL_zero(event);
+        event.type = SDL_EVENT_QUIT;
+        SDL_PushEvent(&event);
     }
     return(status);
 }
 
+/* A version of system() that keeps the UI active */
+static int system_ui(const char *command, const char *log)
+{
+    return(wait_ui(spawn_ui(command, NULL, log, NULL), NULL));
+}
+
+/* Work out how long the main loop can sleep before it has work to do */
+static Sint32 ui_timeout(void)
+{
+    Uint64 now, next;
+
+    next = 0;
+    if ( scroll_y != scroll_target ) {
+        next = scroll_time;
+    }
+    if ( prefetch_demo && (! next || (prefetch_time < next)) ) {
+        next = prefetch_time;
+    }
+    if ( state_due() && (! next || (state_due() < next)) ) {
+        next = state_due();
+    }
+    if ( ! next ) {
+        /* Nothing is going on, wait for input */
+        return(-1);
+    }
+    now = SDL_GetTicks();
+    if ( next <= now ) {
+        return(0);
+    }
+    return((Sint32)(next - now));
+}
+
+/* Keep track of a trip around the main loop, and report every so often.
+   The latency is from when the first event was queued until the screen
+   was updated, for the trips that had an event to handle.
+ */
+static void measure_wakeup(Uint64 event_time)
+{
+    struct damage_stats damage;
+    Uint64 now, latency;
+    double seconds;
+
+    now = SDL_GetTicksNS();
+    if ( ! loop_stats.start ) {
+        loop_stats.start = now;
+    }
+    ++loop_stats.wakeups;
+    if ( event_time ) {
+        latency = now - event_time;
+        ++loop_stats.events;
+        loop_stats.total_latency += latency;
+        if ( latency > loop_stats.max_latency ) {
+            loop_stats.max_latency = latency;
+        }
+    } else {
+        ++loop_stats.idle;
+    }
+
+    if ( (now - loop_stats.start) >= MEASURE_INTERVAL ) {
+        seconds = (now - loop_stats.start) / 1000000000.0;
+        fprintf(stderr,
+            "loop: %.1f wakeups/s, %.1f idle/s, latency %.2f ms avg %.2f ms max\n",
+            loop_stats.wakeups / seconds, loop_stats.idle / seconds,
+            loop_stats.events ?
+                loop_stats.total_latency / loop_stats.events / 1000000.0 : 0.0,
+            loop_stats.max_latency / 1000000.0);
+        damage_get_stats(&damage, 1);
+        if ( damage.frames ) {
+            fprintf(stderr,
+                "present: %.1f frames/s, %.1f rects/frame, "
+                "%.0f pixels/frame of %.0f drawn\n",
+                damage.frames / seconds,
+                (double)damage.rects / damage.frames,
+                (double)damage.pushed / damage.frames,
+                (double)damage.requested / damage.frames);
+        }
+        memset(&loop_stats, 0, sizeof(loop_stats));
+        loop_stats.start = now;
+    }
+}
+
+/* Carry out a request from another copy of the menu.
+   This returns the name of a demo to launch, or NULL.
+ */
+static char *handle_request(const char *request)
+{
+    struct demo *demo;
+    int play;
+
+    if ( strcmp(request, "raise") == 0 ) {
+        SDL_RestoreWindow(window);
+        SDL_RaiseWindow(window);
+        return(NULL);
+    }
+    play = (strncmp(request, "play ", 5) == 0);
+    if ( ! play && (strncmp(request, "select ", 7) != 0) ) {
+        fprintf(stderr, "Unknown request: %s\n", request);
+        return(NULL);
+    }
+    demo = find_demo(strchr(request, ' ')+1);
+    if ( ! demo ) {
+        fprintf(stderr, "No demo named %s\n", strchr(request, ' ')+1);
+        return(NULL);
+    }
+    reveal_demo(demo);
+    activate_demo(demo);
+    if ( ! play ) {
+        return(NULL);
+    }
+    TRACE_BEGIN("click_to_exec", demo->name);
+    click_time = SDL_GetTicksNS();
+    show_plaque(LAUNCH_PLAQUE);
+    return(strdup(demo->name));
+}
+
 static char *run_ui(int *done)
 {
     SDL_Event event;
-    int i;
+    SDL_Event next;
+    Uint64 event_time;
+    float wheel;
+    struct button *button;
     struct demo *list;
     char *command;
 
     command = NULL;
+
+    /* Get to the requests that came in while a demo was launched */
+    requeue_requests();
+
+    /* Sleep until something happens, or there's something left to do */
+    SDL_WaitEventTimeout(NULL, ui_timeout());
+    event_time = 0;
     while ( SDL_PollEvent(&event) ) {
+        if ( ! event_time ) {
+            event_time = event.common.timestamp;
+        }
         switch (event.type) {
             case SDL_EVENT_MOUSE_MOTION:
+                /* Only the latest position matters if the mouse moved on */
+                while ( (SDL_PeepEvents(&next, 1, SDL_PEEKEVENT,
+                                        SDL_EVENT_FIRST, SDL_EVENT_LAST) == 1) &&
+                        (next.type == SDL_EVENT_MOUSE_MOTION) ) {
+                    SDL_PeepEvents(&event, 1, SDL_GETEVENT,
+                                   SDL_EVENT_MOUSE_MOTION,
+                                   SDL_EVENT_MOUSE_MOTION);
+                }
+
                 /* Find out what portion of the UI is being hilited */
+                button = find_button(event.motion.x, event.motion.y, &list);
                 if ( in_demo_panel(event.motion.x, event.motion.y) ) {
-                    for ( list=demos; list; list=list->next ) {
-                        if ( in_button(&list->icon,
-                                       event.motion.x, event.motion.y) ) {
-                            hilite_demo(list);
-                        }
+                    if ( list ) {
+                        hilite_demo(list);
                     }
                 } else {
                     hilite_demo(current_demo);
                 }
-                for ( i=0; i<DEMOS; ++i ) {
-                    if ( in_button(&images[i],
-                                   event.motion.x, event.motion.y) ) {
-                        hilite_button(&images[i]);
-                    } else {
-                        reset_button(&images[i]);
-                    }
+                if ( button && is_image(button) ) {
+                    hilite_button(button);
+                } else if ( hilited_button && is_image(hilited_button) ) {
+                    reset_button(hilited_button);
                 }
                 break;
             case SDL_EVENT_MOUSE_BUTTON_DOWN:
                 /* Find out what portion of the UI is being selected */
-                for ( i=0; i<DEMOS; ++i ) {
-                    if ( in_button(&images[i],
-                                   event.button.x, event.button.y) ) {
-                        select_button(&images[i]);
-                        break;
-                    }
-                }
-                if ( i == DEMOS ) {
-                    for ( list=demos; list; list=list->next ) {
-                        if ( in_button(&list->icon,
-                                       event.button.x, event.button.y) ) {
-                            select_button(&list->icon);
-                        }
-                    }
+                button = find_button(event.button.x, event.button.y, &list);
+                if ( button ) {
+                    select_button(button);
                 }
                 break;
             case SDL_EVENT_MOUSE_BUTTON_UP:
                 /* Find out what portion of the UI is being activated */
                 if ( hilited_button && (hilited_button->state == CLICKED) ) {
-                    for ( i=0; i<DEMOS; ++i ) {
-                        if ( in_button(&images[i],
-                                       event.button.x, event.button.y) ) {
-                            activate_button(&images[i]);
-                            switch (i) {
-                                case LOGO:
-                                    loki_launchURL(LOGO_URL);
-                                    break;
-                                case UPDATE:
-                                    *done = 2;
-                                    break;
-                                case TRAILER:
-                                    play_movie(current_demo->trailer);
-                                    break;
-                                case PLAY:
-                                    command = strdup(current_demo->name);
-                                    show_plaque(LAUNCH_PLAQUE);
-                                    break;
-                                case OPTIONS:
-                                    show_plaque(CONFIG_PLAQUE);
-                                    { char commandline[1024];
-                                        sprintf(commandline, "%s %s",
-                                            CONFIG_APPLET, current_demo->name);
-                                        system_ui(commandline);
-                                    }
-                                    draw_ui();
-                                    break;
-                                case WEBSITE:
-                                    loki_launchURL(STORE_URL);
-                                    break;
-                                case QUIT:
-                                    *done = 1;
-                                    break;
-                            }
-                            break;
+                    button = find_button(event.button.x, event.button.y, &list);
+                    if ( button && is_image(button) ) {
+                        activate_button(button);
+                        switch (button - images) {
+                            case LOGO:
+                                loki_launchURL(LOGO_URL);
+                                break;
+                            case UPDATE:
+                                *done = 2;
+                                break;
+                            case TRAILER:
+                                play_movie(current_demo->trailer);
+                                break;
+                            case PLAY:
+                                TRACE_BEGIN("click_to_exec", current_demo->name);
+                                click_time = SDL_GetTicksNS();
+                                command = strdup(current_demo->name);
+                                show_plaque(LAUNCH_PLAQUE);
+                                break;
+                            case OPTIONS:
+                                show_plaque(CONFIG_PLAQUE);
+                                { char commandline[1024];
+                                    sprintf(commandline, "%s %s",
+                                        CONFIG_APPLET, current_demo->name);
+                                    system_ui(commandline, "demo_config");
+                                }
+                                draw_ui();
+                                break;
+                            case WEBSITE:
+                                loki_launchURL(STORE_URL);
+                                break;
+                            case QUIT:
+                                *done = 1;
+                                break;
                         }
-                    }
-                    if ( i == DEMOS ) {
-                        for ( list=demos; list; list=list->next ) {
-                            if ( in_button(&list->icon,
-                                           event.button.x, event.button.y) ) {
-                                activate_button(&list->icon);
-                                activate_demo(list);
-                            }
+                    } else {
+                        if ( list ) {
+                            activate_button(button);
+                            activate_demo(list);
                         }
                         if ( in_button(&current_demo->box,
                                        event.button.x, event.button.y) ) {
@@ -1033,6 +2053,26 @@ static char *run_ui(int *done)
                     }
                 }
                 break;
+            case SDL_EVENT_MOUSE_WHEEL:
+                /* Scroll the demo panel a row at a time */
+                wheel = event.wheel.y;
+                if ( event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ) {
+                    wheel = -wheel;
+                }
+                if ( wheel > 0 ) {
+                    scroll_demos(-1);
+                } else if ( wheel < 0 ) {
+                    scroll_demos(1);
+                }
+                break;
+            case SDL_EVENT_KEY_DOWN:
+                if ( event.key.key == SDLK_PAGEUP ) {
+                    scroll_demos(-VISIBLE_ROWS);
+                }
+                if ( event.key.key == SDLK_PAGEDOWN ) {
+                    scroll_demos(VISIBLE_ROWS);
+                }
+                break;
             case SDL_EVENT_KEY_UP:
                 if ( event.key.key == SDLK_ESCAPE ) {
                     *done = 1;
@@ -1041,90 +2081,377 @@ static char *run_ui(int *done)
             case SDL_EVENT_QUIT:
                 *done = 1;
                 break;
+            default:
+                if ( event.type == instance_event ) {
+                    if ( command ) {
+                        defer_request(&event);
+                    } else {
+                        command = handle_request(event.user.data1);
+                        free(event.user.data1);
+                    }
+                }
+                break;
         }
     }
+    update_scroll();
+    finish_icons();
     show_dirty_rects();
+    if ( measure_loop ) {
+        measure_wakeup(event_time);
+    }
+
+    /* Load artwork for the demo being looked at */
+    check_prefetch();
 
-    /* Wait for any exiting URL processes */
-    waitpid(-1, NULL, WNOHANG);
+    /* Remember where we are, once the user stops clicking around */
+    state_update();
+
+    /* Wait for any exiting URL processes, leaving the demos to the watcher */
+    if ( ! child_proc_running() ) {
+        waitpid(-1, NULL, WNOHANG);
+    }
 
     return(command);
 }
 
+/* Time blitting an image onto the screen, in nanoseconds per blit */
+static double time_blits(SDL_Surface *image)
+{
+    SDL_Rect area;
+    Uint64 start;
+    int i;
+
+    /* The first blit sets up the blit, and RLE encodes the image */
+    area.x = 0;
+    area.y = 0;
+    SDL_BlitSurface(image, NULL, screen, &area);
+
+    start = SDL_GetTicksNS();
+    for ( i=0; i<BENCH_BLITS; ++i ) {
+        area.x = 0;
+        area.y = 0;
+        SDL_BlitSurface(image, NULL, screen, &area);
+    }
+    return((double)(SDL_GetTicksNS() - start) / BENCH_BLITS);
+}
+
+static void bench_image(const char *path, double before[], double after[],
+                        Uint64 pixels[], int count[])
+{
+    SDL_Surface *image, *prepped;
+    int kind;
+
+    image = IMG_Load(path);
+    if ( ! image ) {
+        return;
+    }
+    kind = surface_classify(image);
+    prepped = SDL_DuplicateSurface(image);
+    if ( prepped ) {
+        prepped = surface_prep(prepped, NULL);
+        before[kind] += time_blits(image);
+        after[kind] += time_blits(prepped);
+        pixels[kind] += (Uint64)image->w * image->h;
+        ++count[kind];
+        SDL_DestroySurface(prepped);
+    }
+    SDL_DestroySurface(image);
+}
+
+/* Compare blitting the artwork as it is decoded with blitting it after
+   surface_prep(), for each class of image, and print the results.
+ */
+static void blit_benchmark(void)
+{
+    static const char *classes[NUM_SURFACE_CLASSES] = {
+        "opaque", "blended", "sparse"
+    };
+    static const char *launch_files[] = {
+        "box_off.png", "box_on.png", "caption.png",
+        "box.png", "text.png", "extra.png"
+    };
+    double before[NUM_SURFACE_CLASSES];
+    double after[NUM_SURFACE_CLASSES];
+    Uint64 pixels[NUM_SURFACE_CLASSES];
+    int count[NUM_SURFACE_CLASSES];
+    char path[PATH_MAX];
+    int i, j;
+
+    memset(before, 0, sizeof(before));
+    memset(after, 0, sizeof(after));
+    memset(pixels, 0, sizeof(pixels));
+    memset(count, 0, sizeof(count));
+    for ( i=0; i<(sizeof images)/(sizeof images[0]); ++i ) {
+        for ( j=0; j<NUM_STATES; ++j ) {
+            if ( images[i].files[j] ) {
+                get_menu_path(images[i].files[j], path, sizeof(path));
+                bench_image(path, before, after, pixels, count);
+            }
+        }
+    }
+    for ( i=0; i<num_demos; ++i ) {
+        for ( j=0; j<SDL_arraysize(launch_files); ++j ) {
+            snprintf(path, sizeof(path), "demos/%s/launch/%s",
+                     demos[i].name, launch_files[j]);
+            if ( access(path, R_OK) == 0 ) {
+                bench_image(path, before, after, pixels, count);
+            }
+        }
+    }
+
+    printf("%-8s %6s %10s %12s %12s %8s\n",
+           "class", "images", "Mpixels", "before ms", "after ms", "speedup");
+    for ( i=0; i<NUM_SURFACE_CLASSES; ++i ) {
+        if ( ! count[i] ) {
+            continue;
+        }
+        printf("%-8s %6d %10.2f %12.3f %12.3f %7.2fx\n",
+               classes[i], count[i], pixels[i] / 1000000.0,
+               before[i] / 1000000.0, after[i] / 1000000.0,
+               after[i] ? before[i] / after[i] : 0.0);
+    }
+}
+
+/* Launch a demo and wait for it to exit, logging how it went.
+   A headless launch blocks instead of keeping the menu window alive.
+   This returns the wait status of the demo, or -1 if it couldn't be run.
+ */
+static int play_demo(const char *demo, int headless)
+{
+    char commandline[PATH_MAX*2];
+    char profile[PATH_MAX];
+    char **env;
+    struct rusage usage;
+    Uint64 exec_time;
+    int status;
+    pid_t child;
+
+    /* Load the demo launch command, and run it if we succeeded */
+    if ( catalog_launch_command(demo, commandline, sizeof(commandline)) < 0 ) {
+        TRACE_END("click_to_exec");
+        fprintf(stderr, "Unable to read launch.txt for %s\n", demo);
+        return(-1);
+    }
+
+    /* Replay what the demo read the last time while it starts up, and
+       if we're asked to, record what it reads the first time it runs.
+     */
+    access_profile_path(demo, profile, sizeof(profile));
+    readahead_start(commandline, profile);
+    env = NULL;
+    if ( record_profiles ) {
+        env = access_profile_record(demo);
+    }
+    child = spawn_ui(commandline, env, demo, demo);
+    TRACE_END("click_to_exec");
+    exec_time = SDL_GetTicksNS();
+    if ( child > 0 ) {
+        state_count_launch(demo);
+    }
+    /* Don't leave the state unsaved for as long as the demo runs */
+    state_save();
+    memset(&usage, 0, sizeof(usage));
+    if ( ! headless ) {
+        status = wait_ui(child, &usage);
+    } else if ( child < 0 ) {
+        status = -1;
+    } else if ( child_proc_wait(child, &status, &usage) < 0 ) {
+        wait4(child, &status, 0, &usage);
+    }
+    telemetry_log(demo, exec_time - click_time,
+                  SDL_GetTicksNS() - exec_time, status, &usage);
+    access_profile_done(demo, env);
+    return(status);
+}
+
+/* Launch a demo straight from the command line, without any UI.
+   This returns the exit code of the demo, the way the shell would.
+ */
+static int launch_headless(const char *demo, long long readahead_budget)
+{
+    int status;
+
+    /* Time the launch from when we were started */
+    click_time = SDL_GetTicksNS();
+    TRACE_BEGIN("click_to_exec", demo);
+    child_proc_init(0);
+    readahead_init(readahead_budget);
+    state_load();
+
+    status = play_demo(demo, 1);
+
+    state_save();
+    state_free();
+    readahead_quit();
+    child_proc_quit();
+    trace_close();
+    if ( status == -1 ) {
+        return(127);
+    }
+    if ( WIFSIGNALED(status) ) {
+        return(128 + WTERMSIG(status));
+    }
+    return(WEXITSTATUS(status));
+}
+
 int main(int argc, char *argv[])
 {
+    int i;
     int use_sound;
+    int serial_load;
+    int rebuild_cache;
+    long long readahead_budget;
+    int list, json;
+    int blit_bench;
+    const char *launch;
+    char requests[1024];
     int done;
     char *demo;
 
-    /* Go to the directory where we are installed, for our data files */
-    goto_installpath(argv[0]);
-
     /* Handle command line arguments */
+    strcpy(requests, "raise\n");
+    list = 0;
+    json = 0;
+    blit_bench = 0;
+    launch = NULL;
     use_sound = 1;
-    if ( argv[1] && ((strcmp(argv[1], "--version") == 0) ||
-                     (strcmp(argv[1], "-V") == 0)) ) {
-        printf("Loki Demo CD " VERSION "\n");
-        return(1);
+    serial_load = 0;
+    rebuild_cache = 0;
+    readahead_budget = READAHEAD_BUDGET;
+    for ( i=1; argv[i]; ++i ) {
+        if ( (strcmp(argv[i], "--version") == 0) ||
+             (strcmp(argv[i], "-V") == 0) ) {
+            printf("Loki Demo CD " VERSION "\n");
+            return(1);
+        }
+        if ( (strcmp(argv[i], "--nosound") == 0) ||
+             (strcmp(argv[i], "-s") == 0) ) {
+            use_sound = 0;
+        } else
+        if ( strcmp(argv[i], "--serial-load") == 0 ) {
+            serial_load = 1;
+        } else
+        if ( strcmp(argv[i], "--rebuild-cache") == 0 ) {
+            rebuild_cache = 1;
+        } else
+        if ( strncmp(argv[i], "--trace=", 8) == 0 ) {
+            trace_open(argv[i]+8);
+        } else
+        if ( strcmp(argv[i], "--measure-loop") == 0 ) {
+            measure_loop = 1;
+        } else
+        if ( strcmp(argv[i], "--record-profiles") == 0 ) {
+            record_profiles = 1;
+        } else
+        if ( strncmp(argv[i], "--readahead=", 12) == 0 ) {
+            /* The number of megabytes to read ahead per demo, 0 for none */
+            readahead_budget = atoll(argv[i]+12) * 1024 * 1024;
+        } else
+        if ( strcmp(argv[i], "--stats") == 0 ) {
+            return(telemetry_stats(NULL) < 0);
+        } else
+        if ( strncmp(argv[i], "--stats=", 8) == 0 ) {
+            return(telemetry_stats(argv[i]+8) < 0);
+        } else
+        if ( strncmp(argv[i], "--select=", 9) == 0 ) {
+            snprintf(requests+strlen(requests),
+                     sizeof(requests)-strlen(requests), "select %s\n", argv[i]+9);
+        } else
+        if ( strcmp(argv[i], "--list") == 0 ) {
+            list = 1;
+        } else
+        if ( strcmp(argv[i], "--json") == 0 ) {
+            json = 1;
+        } else
+        if ( strcmp(argv[i], "--blit-bench") == 0 ) {
+            blit_bench = 1;
+        } else
+        if ( (strcmp(argv[i], "--launch") == 0) && argv[i+1] ) {
+            launch = argv[++i];
+        } else
+        if ( strncmp(argv[i], "--launch=", 9) == 0 ) {
+            launch = argv[i]+9;
+        } else
+        if ( strncmp(argv[i], "--play=", 7) == 0 ) {
+            snprintf(requests+strlen(requests),
+                     sizeof(requests)-strlen(requests), "play %s\n", argv[i]+7);
+        }
     }
-    if ( argv[1] && ((strcmp(argv[1], "--nosound") == 0) ||
-                     (strcmp(argv[1], "-s") == 0)) ) {
-        use_sound = 0;
+
+    /* Listing the demos only needs the catalog */
+    if ( list ) {
+        goto_installpath(argv[0]);
+        return(list_demos(json));
+    }
+
+    /* So does launching a demo directly */
+    if ( launch ) {
+        goto_installpath(argv[0]);
+        return(launch_headless(launch, readahead_budget));
     }
 
-    /* Run the demo play loop */
+    /* If the menu is already running, let it take care of everything.
+       Measuring blits needs a window of our own, and doesn't take over
+       from the running menu, so it never forwards anything.
+     */
+    if ( ! blit_bench && (instance_forward(requests) > 0) ) {
+        return(0);
+    }
+
+    /* Go to the directory where we are installed, for our data files */
+    TRACE_BEGIN("goto_installpath", NULL);
+    goto_installpath(argv[0]);
+    TRACE_END("goto_installpath");
+    surface_cache_init(rebuild_cache);
+
+    /* Start the artwork decoders, one per CPU unless asked not to */
+    decode_pool_init(serial_load ? 0 : -1, load_image);
+
+    /* Start reading the demos ahead of when they're launched */
+    readahead_init(readahead_budget);
+
+    /* Initialize everything */
+    state_load();
+    if ( init_ui(use_sound) < 0 ) {
+        instance_quit();
+        return(-1);
+    }
+    instance_post(requests);
+
+    /* Run the demo play loop, unless we're only here to measure blits */
     done = 0;
+    if ( blit_bench ) {
+        blit_benchmark();
+        done = 1;
+    }
     demo = NULL;
     while ( ! done ) {
-        /* Initialize everything */
-        if ( init_ui(use_sound) < 0 ) {
-            return(-1);
-        }
-
         /* Wait for the user to either quit or select a demo */
         while ( ! done && ! demo ) {
-            /* Be nice and don't hog the CPU */
-            SDL_Delay(20);
-
             demo = run_ui(&done);
         }
 
-        /* Clean up and play selected demo, if any */
-        quit_ui();
+        /* Play the selected demo, if any, and go right back to the menu */
         if ( demo ) {
-            char launch_path[PATH_MAX];
-            char commandline[PATH_MAX*2];
-            FILE *fp;
-
-            /* Load the demo launch command */
-            sprintf(launch_path, "%s/.loki/loki_demos/%s/launch.txt",
-                    getenv("HOME"), demo);
-            fp = fopen(launch_path, "r");
-            if ( ! fp ) {   /* Need to run the preferences applet */
-                sprintf(launch_path, "demos/%s/launch/launch.txt", demo);
-                fp = fopen(launch_path, "r");
-            }
-            /* Read the command line from the launch.txt file */
-            commandline[0] = '\0';
-            if ( fp ) {
-                if ( fgets(commandline, sizeof(commandline), fp) ) {
-                    commandline[strlen(commandline)-1] = '\0';
-                }
-                fclose(fp);
-            }
-            /* If we succeeded, run the command line */
-            if ( commandline[0] ) {
-                system_ui(commandline);
-            } else {
-                fprintf(stderr, "Unable to read launch.txt for %s\n", demo);
-            }
+            suspend_ui();
+            play_demo(demo, 0);
             free(demo);
             demo = NULL;
+            resume_ui(use_sound);
         }
     }
+    quit_ui();
+    instance_quit();
+    state_save();
+    state_free();
+    decode_pool_quit();
+    surface_cache_trim();
+    readahead_quit();
+    child_proc_quit();
+    artpack_close();
     SDL_Quit();
+    trace_close();
     if ( done > 1 ) { /* Perform auto-update */
-        int i;
         const char *args[32];
 
         args[0] = "loki_update";
@@ -0,0 +1,294 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Pack all of the loki_demos artwork into a single prepacked archive,
+   and write the catalog index of installed demos.
+
+   This is run from the loki_demos install directory, after demos have been
+   added or removed:
+        pack_artwork [--format XRGB8888] [output]
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+
+#include <SDL3/SDL.h>
+#include <SDL3_image/SDL_image.h>
+#include "artpack.h"
+#include "catalog.h"
+#include "surface_prep.h"
+
+#define MENU    "menu"
+
+static struct {
+    const char *name;
+    SDL_PixelFormat format;
+} format_list[] = {
+    { "XRGB8888", SDL_PIXELFORMAT_XRGB8888 },
+    { "ARGB8888", SDL_PIXELFORMAT_ARGB8888 },
+    { "XBGR8888", SDL_PIXELFORMAT_XBGR8888 },
+    { "RGB565",   SDL_PIXELFORMAT_RGB565 }
+};
+
+static char **files;
+static int num_files, max_files;
+
+static void add_file(const char *dir, const char *file)
+{
+    char path[PATH_MAX];
+    size_t len;
+
+    len = strlen(file);
+    if ( (len < 4) || (strcasecmp(file+len-4, ".png") != 0) ) {
+        return;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    if ( num_files == max_files ) {
+        max_files += 64;
+        files = (char **)realloc(files, max_files*(sizeof *files));
+        if ( ! files ) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    files[num_files++] = strdup(path);
+}
+
+static void add_dir(const char *dir)
+{
+    DIR *dp;
+    struct dirent *entry;
+
+    dp = opendir(dir);
+    if ( dp ) {
+        while ( (entry=readdir(dp)) != NULL ) {
+            if ( entry->d_name[0] != '.' ) {
+                add_file(dir, entry->d_name);
+            }
+        }
+        closedir(dp);
+    }
+}
+
+/* This must match get_menu_path() in loki_demos.c */
+static void get_menu_dir(char *menu, int maxlen)
+{
+    FILE *fp;
+
+    strcpy(menu, MENU);
+    fp = fopen("menu.txt", "r");
+    if ( fp ) {
+        if ( fgets(menu, maxlen, fp) ) {
+            menu[strlen(menu)-1] = '\0';
+        }
+        fclose(fp);
+    }
+}
+
+static int compare_files(const void *a, const void *b)
+{
+    return(strcmp(*(char * const *)a, *(char * const *)b));
+}
+
+static int write_pad(FILE *fp, long *offset)
+{
+    while ( *offset % ARTPACK_ALIGN ) {
+        if ( fputc(0, fp) == EOF ) {
+            return(-1);
+        }
+        ++*offset;
+    }
+    return(0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output;
+    SDL_PixelFormat format;
+    struct artpack_header header;
+    struct artpack_entry *entries;
+    SDL_Surface *image, *converted;
+    struct stat sb;
+    char menu[128];
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    DIR *dir;
+    struct dirent *entry;
+    FILE *fp;
+    long offset;
+    int i, row, packed, kind;
+
+    /* Handle command line arguments */
+    output = ARTPACK_FILE;
+    format = SDL_PIXELFORMAT_XRGB8888;
+    for ( i=1; argv[i]; ++i ) {
+        if ( (strcmp(argv[i], "--format") == 0) && argv[i+1] ) {
+            int f;
+
+            ++i;
+            for ( f=0; f<SDL_arraysize(format_list); ++f ) {
+                if ( strcasecmp(argv[i], format_list[f].name) == 0 ) {
+                    format = format_list[f].format;
+                    break;
+                }
+            }
+            if ( f == SDL_arraysize(format_list) ) {
+                fprintf(stderr, "Unknown pixel format: %s\n", argv[i]);
+                return(1);
+            }
+        } else
+        if ( argv[i][0] != '-' ) {
+            output = argv[i];
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--format XRGB8888] [output]\n", argv[0]);
+            return(1);
+        }
+    }
+
+    surface_prep_format(format);
+
+    /* Index the demos, so loki_demos doesn't have to probe each one */
+    i = catalog_write(CATALOG_FILE);
+    if ( i >= 0 ) {
+        printf("Indexed %d demos into %s\n", i, CATALOG_FILE);
+    }
+
+    /* Find all of the artwork */
+    get_menu_dir(menu, sizeof(menu));
+    add_dir(menu);
+    dir = opendir("demos");
+    if ( dir ) {
+        while ( (entry=readdir(dir)) != NULL ) {
+            if ( entry->d_name[0] != '.' ) {
+                snprintf(path, sizeof(path), "demos/%s/launch", entry->d_name);
+                add_dir(path);
+            }
+        }
+        closedir(dir);
+    }
+    if ( num_files == 0 ) {
+        fprintf(stderr, "No artwork found, run this in the install path\n");
+        return(1);
+    }
+    /* The archive is searched by path */
+    qsort(files, num_files, sizeof(*files), compare_files);
+
+    entries = (struct artpack_entry *)calloc(num_files, sizeof(*entries));
+    if ( ! entries ) {
+        fprintf(stderr, "Out of memory\n");
+        return(1);
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARTPACK_MAGIC, sizeof(ARTPACK_MAGIC));
+    header.version = ARTPACK_VERSION;
+    header.format = format;
+    header.num_entries = num_files;
+    header.strings_offset = sizeof(header) + num_files*sizeof(*entries);
+    for ( i=0; i<num_files; ++i ) {
+        entries[i].path = header.strings_size;
+        header.strings_size += strlen(files[i])+1;
+    }
+
+    /* Write the archive to a temporary file, and rename it when done */
+    snprintf(temp, sizeof(temp), "%s.tmp", output);
+    fp = fopen(temp, "wb");
+    if ( ! fp ) {
+        perror(temp);
+        return(1);
+    }
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(entries, sizeof(*entries), num_files, fp);
+    for ( i=0; i<num_files; ++i ) {
+        fwrite(files[i], strlen(files[i])+1, 1, fp);
+    }
+    offset = header.strings_offset + header.strings_size;
+
+    packed = 0;
+    for ( i=0; i<num_files; ++i ) {
+        if ( stat(files[i], &sb) < 0 ) {
+            continue;
+        }
+        image = IMG_Load(files[i]);
+        if ( ! image ) {
+            fprintf(stderr, "Warning: couldn't load %s: %s\n",
+                    files[i], SDL_GetError());
+            continue;
+        }
+        /* Opaque images are stored in the window format, the rest keep
+           their alpha channel so they can be blended onto the window.
+           The class is stored too, so the menu doesn't have to look at
+           the pixels again.
+         */
+        converted = surface_prep(image, &kind);
+        if ( (kind == SURFACE_OPAQUE) ?
+             (converted->format != format) :
+             (converted->format != SDL_PIXELFORMAT_ARGB8888) ) {
+            fprintf(stderr, "Warning: couldn't convert %s: %s\n",
+                    files[i], SDL_GetError());
+            SDL_DestroySurface(converted);
+            continue;
+        }
+
+        if ( write_pad(fp, &offset) < 0 ) {
+            break;
+        }
+        entries[i].format = converted->format;
+        entries[i].w = converted->w;
+        entries[i].h = converted->h;
+        entries[i].pitch = converted->pitch;
+        entries[i].surface_class = kind;
+        entries[i].mtime = sb.st_mtime;
+        entries[i].size = sb.st_size;
+        entries[i].offset = offset;
+        SDL_LockSurface(converted);
+        for ( row=0; row<converted->h; ++row ) {
+            fwrite((Uint8 *)converted->pixels + row*converted->pitch,
+                   converted->pitch, 1, fp);
+        }
+        SDL_UnlockSurface(converted);
+        offset += (long)converted->pitch * converted->h;
+        SDL_DestroySurface(converted);
+        ++packed;
+    }
+
+    /* Now that we know where everything is, write the entry table */
+    fseek(fp, sizeof(header), SEEK_SET);
+    fwrite(entries, sizeof(*entries), num_files, fp);
+    if ( ferror(fp) | fclose(fp) ) {
+        fprintf(stderr, "Couldn't write %s\n", temp);
+        unlink(temp);
+        return(1);
+    }
+    if ( rename(temp, output) < 0 ) {
+        perror(output);
+        unlink(temp);
+        return(1);
+    }
+    printf("Packed %d of %d images into %s (%ld bytes)\n",
+           packed, num_files, output, offset);
+    return(0);
+}
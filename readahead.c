@@ -0,0 +1,351 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Reading a demo's files into the page cache in the background */
+
+#define _GNU_SOURCE     /* For readahead() */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+
+#include <SDL3/SDL.h>
+#include "readahead.h"
+#include "child_proc.h"
+#include "trace.h"
+
+#define READAHEAD_CHUNK     (1024*1024)
+#define MAX_DEPTH           3
+
+static long long budget;
+static SDL_Thread *thread;
+static SDL_Mutex *lock;
+static SDL_Condition *wakeup;
+static char *request;           /* The command line to read ahead next */
+static char *request_profile;
+static int request_generation;
+static SDL_AtomicInt generation;
+static int quitting;
+
+/* The last program or profile completely read ahead, used by the thread */
+static char last_program[PATH_MAX];
+
+static int cancelled(int my_generation)
+{
+    return(SDL_GetAtomicInt(&generation) != my_generation);
+}
+
+/* Read ahead a file, a chunk at a time so a new request isn't kept waiting.
+   This returns 0, or -1 if the read ahead was cancelled.
+ */
+static int read_file(const char *path, long long *left, int my_generation)
+{
+    struct stat sb;
+    off_t offset, len;
+    int fd;
+
+    fd = open(path, O_RDONLY|O_CLOEXEC);
+    if ( fd < 0 ) {
+        return(0);
+    }
+    if ( (fstat(fd, &sb) == 0) && S_ISREG(sb.st_mode) ) {
+        for ( offset=0; (offset < sb.st_size) && (*left > 0); offset += len ) {
+            if ( cancelled(my_generation) ) {
+                close(fd);
+                return(-1);
+            }
+            len = sb.st_size - offset;
+            if ( len > READAHEAD_CHUNK ) {
+                len = READAHEAD_CHUNK;
+            }
+            if ( len > *left ) {
+                len = *left;
+            }
+            if ( readahead(fd, offset, len) < 0 ) {
+                posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+            }
+            *left -= len;
+        }
+    }
+    close(fd);
+    return(0);
+}
+
+static int read_dir(const char *dir, int depth, long long *left, int my_generation)
+{
+    DIR *dp;
+    struct dirent *entry;
+    struct stat sb;
+    char path[PATH_MAX];
+    int result;
+
+    dp = opendir(dir);
+    if ( ! dp ) {
+        return(0);
+    }
+    result = 0;
+    while ( (result == 0) && (*left > 0) && (entry=readdir(dp)) != NULL ) {
+        if ( entry->d_name[0] == '.' ) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if ( stat(path, &sb) < 0 ) {
+            continue;
+        }
+        if ( S_ISDIR(sb.st_mode) ) {
+            if ( depth < MAX_DEPTH ) {
+                result = read_dir(path, depth+1, left, my_generation);
+            }
+        } else {
+            result = read_file(path, left, my_generation);
+        }
+    }
+    closedir(dp);
+    return(result);
+}
+
+/* Replay the parts of files in an access profile, in the order the demo
+   read them.  This returns 0, -1 if the read ahead was cancelled, or 1 if
+   there is no profile.
+ */
+static int read_profile(const char *profile, long long *left, int my_generation)
+{
+    FILE *fp;
+    char line[PATH_MAX+64];
+    char path[PATH_MAX];
+    char *tab;
+    long long offset, len, chunk;
+    int fd, result;
+
+    fp = fopen(profile, "r");
+    if ( ! fp ) {
+        return(1);
+    }
+    path[0] = '\0';
+    fd = -1;
+    result = 0;
+    while ( (result == 0) && (*left > 0) && fgets(line, sizeof(line), fp) ) {
+        tab = strchr(line, '\t');
+        if ( ! tab || (sscanf(tab+1, "%lld %lld", &offset, &len) != 2) ) {
+            continue;
+        }
+        *tab = '\0';
+
+        /* The same file usually shows up several times in a row */
+        if ( strcmp(line, path) != 0 ) {
+            if ( fd >= 0 ) {
+                close(fd);
+            }
+            strcpy(path, line);
+            fd = open(path, O_RDONLY|O_CLOEXEC);
+        }
+        for ( ; (fd >= 0) && (len > 0) && (*left > 0); offset += chunk ) {
+            if ( cancelled(my_generation) ) {
+                result = -1;
+                break;
+            }
+            chunk = len;
+            if ( chunk > READAHEAD_CHUNK ) {
+                chunk = READAHEAD_CHUNK;
+            }
+            if ( chunk > *left ) {
+                chunk = *left;
+            }
+            if ( readahead(fd, offset, chunk) < 0 ) {
+                posix_fadvise(fd, offset, chunk, POSIX_FADV_WILLNEED);
+            }
+            len -= chunk;
+            *left -= chunk;
+        }
+    }
+    if ( fd >= 0 ) {
+        close(fd);
+    }
+    fclose(fp);
+    return(result);
+}
+
+static void read_demo(const char *command, const char *profile,
+                      int my_generation)
+{
+    char program[PATH_MAX];
+    char real_path[PATH_MAX];
+    char *dir;
+    long long left;
+    int result;
+
+    /* The profile knows exactly what the demo is going to read */
+    if ( profile && (strcmp(profile, last_program) != 0) ) {
+        TRACE_BEGIN("readahead", profile);
+        left = budget;
+        result = read_profile(profile, &left, my_generation);
+        if ( result == 0 ) {
+            strcpy(last_program, profile);
+        }
+        TRACE_END("readahead");
+        if ( result <= 0 ) {
+            return;
+        }
+    } else if ( profile ) {
+        /* We just did this one */
+        return;
+    }
+
+    if ( (child_proc_program(command, program, sizeof(program)) < 0) ||
+         ! realpath(program, real_path) ) {
+        return;
+    }
+    if ( strcmp(real_path, last_program) == 0 ) {
+        /* We just did this one */
+        return;
+    }
+
+    TRACE_BEGIN("readahead", real_path);
+    left = budget;
+    result = read_file(real_path, &left, my_generation);
+
+    /* The data usually lives next to the program, unless it's installed
+       in a bin directory with everything else on the system.
+     */
+    dir = strrchr(real_path, '/');
+    if ( (result == 0) && dir && (dir != real_path) ) {
+        *dir = '\0';
+        dir = strrchr(real_path, '/');
+        if ( ! dir || ((strcmp(dir+1, "bin") != 0) &&
+                       (strcmp(dir+1, "sbin") != 0)) ) {
+            result = read_dir(real_path, 0, &left, my_generation);
+        }
+        real_path[strlen(real_path)] = '/';
+    }
+    if ( result == 0 ) {
+        strcpy(last_program, real_path);
+    }
+    TRACE_END("readahead");
+}
+
+static int readahead_thread(void *unused)
+{
+    char *command, *profile;
+    int my_generation;
+
+    SDL_LockMutex(lock);
+    for ( ; ; ) {
+        while ( ! request && ! quitting ) {
+            SDL_WaitCondition(wakeup, lock);
+        }
+        if ( quitting ) {
+            break;
+        }
+        command = request;
+        profile = request_profile;
+        my_generation = request_generation;
+        request = NULL;
+        request_profile = NULL;
+        SDL_UnlockMutex(lock);
+
+        read_demo(command, profile, my_generation);
+        free(command);
+        free(profile);
+
+        SDL_LockMutex(lock);
+    }
+    SDL_UnlockMutex(lock);
+    return(0);
+}
+
+int readahead_init(long long bytes)
+{
+    budget = bytes;
+    if ( budget <= 0 ) {
+        return(0);
+    }
+    lock = SDL_CreateMutex();
+    wakeup = SDL_CreateCondition();
+    if ( ! lock || ! wakeup ) {
+        fprintf(stderr, "Couldn't create read ahead thread: %s\n",
+                SDL_GetError());
+        readahead_quit();
+        return(-1);
+    }
+    quitting = 0;
+    thread = SDL_CreateThread(readahead_thread, "readahead", NULL);
+    if ( ! thread ) {
+        fprintf(stderr, "Couldn't create read ahead thread: %s\n",
+                SDL_GetError());
+        readahead_quit();
+        return(-1);
+    }
+    return(0);
+}
+
+void readahead_start(const char *command, const char *profile)
+{
+    if ( ! thread ) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    free(request);
+    free(request_profile);
+    request = strdup(command);
+    request_profile = profile ? strdup(profile) : NULL;
+    request_generation = SDL_AddAtomicInt(&generation, 1) + 1;
+    SDL_SignalCondition(wakeup);
+    SDL_UnlockMutex(lock);
+}
+
+void readahead_cancel(void)
+{
+    if ( ! thread ) {
+        return;
+    }
+    SDL_LockMutex(lock);
+    free(request);
+    free(request_profile);
+    request = NULL;
+    request_profile = NULL;
+    SDL_AddAtomicInt(&generation, 1);
+    SDL_UnlockMutex(lock);
+}
+
+void readahead_quit(void)
+{
+    if ( thread ) {
+        readahead_cancel();
+        SDL_LockMutex(lock);
+        quitting = 1;
+        SDL_SignalCondition(wakeup);
+        SDL_UnlockMutex(lock);
+        SDL_WaitThread(thread, NULL);
+        thread = NULL;
+    }
+    if ( wakeup ) {
+        SDL_DestroyCondition(wakeup);
+        wakeup = NULL;
+    }
+    if ( lock ) {
+        SDL_DestroyMutex(lock);
+        lock = NULL;
+    }
+}
@@ -0,0 +1,49 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Reading a demo's program and data files into the page cache in the
+   background, while the user is still deciding whether to launch it.
+
+   If the demo has an access profile of what it read the last time it
+   started up, exactly that is read, in the same order.  Otherwise the
+   program is found from the launch.txt command line, and the rest of the
+   directory it lives in is read after it.  Either way it stops at a budget
+   of bytes per demo, and starting another demo cancels the one in progress.
+ */
+
+#define READAHEAD_BUDGET    (64*1024*1024)
+
+/* Start the read ahead thread, with a budget in bytes per demo.
+   A budget of 0 turns read ahead off.
+   This returns 0, or -1 if the thread couldn't be started.
+ */
+extern int readahead_init(long long budget);
+
+/* Read ahead the files for a launch.txt command line, in the background,
+   using the access profile if there is one.
+   This replaces any read ahead in progress.
+ */
+extern void readahead_start(const char *command, const char *profile);
+
+/* Stop any read ahead in progress */
+extern void readahead_cancel(void);
+
+/* Stop the read ahead thread */
+extern void readahead_quit(void);
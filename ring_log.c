@@ -0,0 +1,193 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Bounded logs of what launched programs print */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+
+#include "ring_log.h"
+
+struct ring_log {
+    char path[PATH_MAX];
+    char data[RING_LOG_SIZE];
+    int start;
+    int used;
+    long long dropped;
+};
+
+struct ring_log *ring_log_create(const char *name)
+{
+    struct ring_log *log;
+    char banner[128];
+    time_t now;
+
+    log = (struct ring_log *)malloc(sizeof(*log));
+    if ( ! log ) {
+        return(NULL);
+    }
+    snprintf(log->path, sizeof(log->path), "%s/.loki", getenv("HOME"));
+    mkdir(log->path, 0700);
+    strcat(log->path, "/loki_demos");
+    mkdir(log->path, 0700);
+    strcat(log->path, "/logs");
+    mkdir(log->path, 0700);
+    snprintf(log->path, sizeof(log->path), "%s/.loki/loki_demos/logs/%s.log",
+             getenv("HOME"), name);
+    log->start = 0;
+    log->used = 0;
+    log->dropped = 0;
+
+    /* Mark where each run starts, since the log is shared by all of them */
+    now = time(NULL);
+    strftime(banner, sizeof(banner), "--- %Y-%m-%d %H:%M:%S ---\n",
+             localtime(&now));
+    ring_log_write(log, banner, strlen(banner));
+    return(log);
+}
+
+void ring_log_write(struct ring_log *log, const char *data, int len)
+{
+    int end, chunk;
+
+    /* Only the newest output fits */
+    if ( len > RING_LOG_SIZE ) {
+        log->dropped += len - RING_LOG_SIZE;
+        data += len - RING_LOG_SIZE;
+        len = RING_LOG_SIZE;
+    }
+    if ( log->used + len > RING_LOG_SIZE ) {
+        chunk = log->used + len - RING_LOG_SIZE;
+        log->start = (log->start + chunk) % RING_LOG_SIZE;
+        log->used -= chunk;
+        log->dropped += chunk;
+    }
+    while ( len > 0 ) {
+        end = (log->start + log->used) % RING_LOG_SIZE;
+        chunk = RING_LOG_SIZE - end;
+        if ( chunk > len ) {
+            chunk = len;
+        }
+        memcpy(&log->data[end], data, chunk);
+        log->used += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+int ring_log_pending(struct ring_log *log)
+{
+    return(log->used);
+}
+
+/* Move the log out of the way once it gets too big */
+static void rotate_log(const char *path)
+{
+    char old_path[PATH_MAX];
+    char new_path[PATH_MAX];
+    int i;
+
+    for ( i=RING_LOG_KEEP; i>1; --i ) {
+        snprintf(old_path, sizeof(old_path), "%s.%d", path, i-1);
+        snprintf(new_path, sizeof(new_path), "%s.%d", path, i);
+        rename(old_path, new_path);
+    }
+    snprintf(new_path, sizeof(new_path), "%s.1", path);
+    rename(path, new_path);
+}
+
+struct ring_log_batch *ring_log_take(struct ring_log *log)
+{
+    struct ring_log_batch *batch;
+    int chunk;
+
+    if ( ! log->used && ! log->dropped ) {
+        return(NULL);
+    }
+    batch = (struct ring_log_batch *)malloc(sizeof(*batch));
+    if ( batch ) {
+        batch->next = NULL;
+        strcpy(batch->path, log->path);
+        batch->dropped = log->dropped;
+        batch->used = log->used;
+        chunk = RING_LOG_SIZE - log->start;
+        if ( chunk > log->used ) {
+            chunk = log->used;
+        }
+        memcpy(batch->data, &log->data[log->start], chunk);
+        memcpy(batch->data + chunk, log->data, log->used - chunk);
+    }
+    /* Without the memory for a batch, the output is lost */
+    log->start = 0;
+    log->used = 0;
+    log->dropped = 0;
+    return(batch);
+}
+
+void ring_log_save(struct ring_log_batch *batch)
+{
+    char note[64];
+    struct stat sb;
+    int fd;
+
+    if ( ! batch ) {
+        return;
+    }
+    if ( (stat(batch->path, &sb) == 0) &&
+         (sb.st_size + batch->used > RING_LOG_MAX_FILE) ) {
+        rotate_log(batch->path);
+    }
+    fd = open(batch->path, O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC, 0600);
+    if ( fd >= 0 ) {
+        if ( batch->dropped ) {
+            snprintf(note, sizeof(note), "[%lld bytes of output dropped]\n",
+                     batch->dropped);
+            if ( write(fd, note, strlen(note)) < 0 ) {
+                /* Nothing we can do about it */
+            }
+        }
+        /* Whatever couldn't be written is lost, rather than held on to */
+        if ( write(fd, batch->data, batch->used) < 0 ) {
+            /* Nothing we can do about it */
+        }
+        close(fd);
+    }
+    free(batch);
+}
+
+void ring_log_flush(struct ring_log *log)
+{
+    ring_log_save(ring_log_take(log));
+}
+
+void ring_log_destroy(struct ring_log *log)
+{
+    if ( log ) {
+        ring_log_flush(log);
+        free(log);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Bounded logs of what launched programs print
+
+   Output is collected into a fixed size ring buffer, so a program that
+   prints faster than the log can be written only loses its oldest output,
+   and never has to wait for us.  The ring is flushed to
+   ~/.loki/loki_demos/logs/<name>.log, which is rotated once it gets big.
+   The output can also be taken out of the ring in a batch, so that it
+   can be written to the file without holding up whoever owns the ring.
+ */
+
+#include <limits.h>
+
+#define RING_LOG_SIZE       (64*1024)       /* Bytes buffered per log */
+#define RING_LOG_MAX_FILE   (1024*1024)     /* Size of a log before rotating */
+#define RING_LOG_KEEP       3               /* Rotated logs kept */
+
+struct ring_log;
+
+/* Output taken out of a log, waiting to be written to its file */
+struct ring_log_batch {
+    struct ring_log_batch *next;    /* For queueing batches */
+    char path[PATH_MAX];
+    long long dropped;
+    int used;
+    char data[RING_LOG_SIZE];
+};
+
+/* Create the ring buffer for a log.
+   This returns NULL if we're out of memory.
+ */
+extern struct ring_log *ring_log_create(const char *name);
+
+/* Add output to the log, dropping the oldest output if the ring is full */
+extern void ring_log_write(struct ring_log *log, const char *data, int len);
+
+/* Return how many bytes are waiting to be flushed */
+extern int ring_log_pending(struct ring_log *log);
+
+/* Take what has been collected so far out of the log, without writing it.
+   This returns NULL if there's nothing to write, or we're out of memory.
+ */
+extern struct ring_log_batch *ring_log_take(struct ring_log *log);
+
+/* Write a batch to its log file, rotating the file if needed, and free it */
+extern void ring_log_save(struct ring_log_batch *batch);
+
+/* Write out what has been collected so far */
+extern void ring_log_flush(struct ring_log *log);
+
+/* Flush and free a log */
+extern void ring_log_destroy(struct ring_log *log);
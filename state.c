@@ -0,0 +1,388 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* The menu state that is remembered between runs */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include <SDL3/SDL.h>
+#include "state.h"
+
+struct launch_count {
+    char *demo;
+    int launches;
+};
+
+static char *last_demo;
+static int scroll;
+static struct launch_count *counts;
+static int num_counts;
+static Uint64 due;
+static int migrated;
+
+/* The thread that writes the state, so the UI never waits for fsync() */
+static SDL_Thread *writer;
+static SDL_Mutex *write_lock;
+static SDL_Condition *write_ready;
+static char *write_text;        /* The next state to write, or NULL */
+static int write_migrated;      /* Remove last_demo.txt once it's written */
+static int writer_quitting;
+
+static void get_state_path(char *path, int maxlen, const char *file)
+{
+    snprintf(path, maxlen, "%s/.loki/loki_demos/%s", getenv("HOME"), file);
+}
+
+/* Note that the state changed, and put off writing it a little longer */
+static void state_changed(void)
+{
+    due = SDL_GetTicks() + STATE_DEBOUNCE;
+}
+
+static struct launch_count *find_count(const char *demo, int create)
+{
+    struct launch_count *count;
+    int i;
+
+    for ( i=0; i<num_counts; ++i ) {
+        if ( strcmp(counts[i].demo, demo) == 0 ) {
+            return(&counts[i]);
+        }
+    }
+    if ( ! create ) {
+        return(NULL);
+    }
+    count = (struct launch_count *)realloc(counts,
+                                           (num_counts+1)*(sizeof *counts));
+    if ( ! count ) {
+        return(NULL);
+    }
+    counts = count;
+    count = &counts[num_counts];
+    count->demo = strdup(demo);
+    if ( ! count->demo ) {
+        return(NULL);
+    }
+    count->launches = 0;
+    ++num_counts;
+    return(count);
+}
+
+/* Older versions only remembered the last demo */
+static int migrate_last_demo(void)
+{
+    char path[PATH_MAX];
+    char line[PATH_MAX];
+    FILE *fp;
+
+    get_state_path(path, sizeof(path), "last_demo.txt");
+    fp = fopen(path, "r");
+    if ( ! fp ) {
+        return(-1);
+    }
+    if ( fgets(line, sizeof(line), fp) ) {
+        line[strcspn(line, "\r\n")] = '\0';
+        state_set_last_demo(line);
+    }
+    fclose(fp);
+    migrated = 1;
+    return(0);
+}
+
+int state_load(void)
+{
+    char path[PATH_MAX];
+    char line[PATH_MAX];
+    struct launch_count *count;
+    char *value;
+    FILE *fp;
+    int n;
+
+    state_free();
+    get_state_path(path, sizeof(path), STATE_FILE);
+    fp = fopen(path, "r");
+    if ( ! fp ) {
+        return(migrate_last_demo());
+    }
+    while ( fgets(line, sizeof(line), fp) ) {
+        line[strcspn(line, "\r\n")] = '\0';
+        value = strchr(line, ' ');
+        if ( ! value ) {
+            continue;
+        }
+        *value++ = '\0';
+        if ( strcmp(line, "last_demo") == 0 ) {
+            free(last_demo);
+            last_demo = strdup(value);
+        } else
+        if ( strcmp(line, "scroll") == 0 ) {
+            scroll = atoi(value);
+        } else
+        if ( strcmp(line, "launches") == 0 ) {
+            /* The count comes first, since demo names may have spaces */
+            n = atoi(value);
+            value = strchr(value, ' ');
+            if ( value && (count=find_count(value+1, 1)) != NULL ) {
+                count->launches = n;
+            }
+        }
+    }
+    fclose(fp);
+    due = 0;
+    return(0);
+}
+
+const char *state_last_demo(void)
+{
+    return(last_demo);
+}
+
+void state_set_last_demo(const char *demo)
+{
+    if ( last_demo && (strcmp(demo, last_demo) == 0) ) {
+        return;
+    }
+    free(last_demo);
+    last_demo = strdup(demo);
+    state_changed();
+}
+
+int state_scroll(void)
+{
+    return(scroll);
+}
+
+void state_set_scroll(int new_scroll)
+{
+    if ( new_scroll != scroll ) {
+        scroll = new_scroll;
+        state_changed();
+    }
+}
+
+int state_launches(const char *demo)
+{
+    struct launch_count *count;
+
+    count = find_count(demo, 0);
+    return(count ? count->launches : 0);
+}
+
+void state_count_launch(const char *demo)
+{
+    struct launch_count *count;
+
+    count = find_count(demo, 1);
+    if ( count ) {
+        ++count->launches;
+        state_changed();
+    }
+}
+
+Uint64 state_due(void)
+{
+    return(due);
+}
+
+void state_update(void)
+{
+    if ( due && (SDL_GetTicks() >= due) ) {
+        state_save();
+    }
+}
+
+/* Replace the state file with new contents */
+static int write_state(const char *text, int remove_old)
+{
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    FILE *fp;
+    int result;
+
+    sprintf(temp, "%s/.loki", getenv("HOME"));
+    mkdir(temp, 0700);
+    strcat(temp, "/loki_demos");
+    mkdir(temp, 0700);
+    get_state_path(path, sizeof(path), STATE_FILE);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    fp = fopen(temp, "w");
+    if ( ! fp ) {
+        return(-1);
+    }
+    fputs(text, fp);
+
+    /* Make sure the new state is on disk before it replaces the old one */
+    result = 0;
+    if ( (fflush(fp) != 0) || (fsync(fileno(fp)) < 0) ) {
+        result = -1;
+    }
+    if ( (fclose(fp) != 0) || (result < 0) || (rename(temp, path) < 0) ) {
+        unlink(temp);
+        return(-1);
+    }
+    if ( remove_old ) {
+        get_state_path(path, sizeof(path), "last_demo.txt");
+        unlink(path);
+    }
+    return(0);
+}
+
+static int state_writer(void *unused)
+{
+    char *text;
+    int remove_old;
+
+    SDL_LockMutex(write_lock);
+    for ( ; ; ) {
+        while ( ! write_text && ! writer_quitting ) {
+            SDL_WaitCondition(write_ready, write_lock);
+        }
+        if ( ! write_text ) {
+            break;
+        }
+        /* Only the newest state matters, anything older is replaced */
+        text = write_text;
+        remove_old = write_migrated;
+        write_text = NULL;
+        write_migrated = 0;
+        SDL_UnlockMutex(write_lock);
+
+        if ( write_state(text, remove_old) < 0 ) {
+            fprintf(stderr, "Warning: couldn't save the menu state\n");
+        }
+        free(text);
+
+        SDL_LockMutex(write_lock);
+    }
+    SDL_UnlockMutex(write_lock);
+    return(0);
+}
+
+/* Stop the writer, after it writes whatever it was handed */
+static void stop_writer(void)
+{
+    if ( writer ) {
+        SDL_LockMutex(write_lock);
+        writer_quitting = 1;
+        SDL_SignalCondition(write_ready);
+        SDL_UnlockMutex(write_lock);
+        SDL_WaitThread(writer, NULL);
+        writer = NULL;
+    }
+    if ( write_ready ) {
+        SDL_DestroyCondition(write_ready);
+        write_ready = NULL;
+    }
+    if ( write_lock ) {
+        SDL_DestroyMutex(write_lock);
+        write_lock = NULL;
+    }
+}
+
+static int start_writer(void)
+{
+    if ( writer ) {
+        return(0);
+    }
+    write_lock = SDL_CreateMutex();
+    write_ready = SDL_CreateCondition();
+    if ( write_lock && write_ready ) {
+        writer_quitting = 0;
+        writer = SDL_CreateThread(state_writer, "state_writer", NULL);
+    }
+    if ( ! writer ) {
+        stop_writer();
+        return(-1);
+    }
+    return(0);
+}
+
+int state_save(void)
+{
+    char *text;
+    size_t size;
+    FILE *fp;
+    int i, result;
+
+    if ( ! due ) {
+        return(0);
+    }
+    /* Don't keep trying if the disk is full or the like */
+    due = 0;
+
+    text = NULL;
+    fp = open_memstream(&text, &size);
+    if ( ! fp ) {
+        return(-1);
+    }
+    if ( last_demo ) {
+        fprintf(fp, "last_demo %s\n", last_demo);
+    }
+    fprintf(fp, "scroll %d\n", scroll);
+    for ( i=0; i<num_counts; ++i ) {
+        fprintf(fp, "launches %d %s\n", counts[i].launches, counts[i].demo);
+    }
+    if ( fclose(fp) != 0 ) {
+        free(text);
+        return(-1);
+    }
+
+    /* Without a thread to hand it to, it's written right here */
+    if ( start_writer() < 0 ) {
+        result = write_state(text, migrated);
+        free(text);
+        if ( result == 0 ) {
+            migrated = 0;
+        }
+        return(result);
+    }
+    SDL_LockMutex(write_lock);
+    free(write_text);
+    write_text = text;
+    write_migrated |= migrated;
+    SDL_SignalCondition(write_ready);
+    SDL_UnlockMutex(write_lock);
+    migrated = 0;
+    return(0);
+}
+
+void state_free(void)
+{
+    int i;
+
+    stop_writer();
+    free(last_demo);
+    last_demo = NULL;
+    for ( i=0; i<num_counts; ++i ) {
+        free(counts[i].demo);
+    }
+    free(counts);
+    counts = NULL;
+    num_counts = 0;
+    scroll = 0;
+    due = 0;
+    migrated = 0;
+}
@@ -0,0 +1,65 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* The menu state that is remembered between runs
+
+   The state is kept in memory, and written to ~/.loki/loki_demos/state.txt
+   a little while after it stops changing, or when asked to, so clicking
+   around the menu never waits for the disk.  The file is replaced
+   atomically, so a crash leaves either the old state or the new one.
+ */
+
+#include <SDL3/SDL.h>
+
+#define STATE_FILE      "state.txt"
+#define STATE_DEBOUNCE  2000        /* Milliseconds to wait for quiet */
+
+/* Load the saved state, or the last_demo.txt of older versions.
+   This returns 0, or -1 if there was no saved state.
+ */
+extern int state_load(void);
+
+/* The demo that was selected last, or NULL */
+extern const char *state_last_demo(void);
+extern void state_set_last_demo(const char *demo);
+
+/* How far the demo panel was scrolled */
+extern int state_scroll(void);
+extern void state_set_scroll(int scroll);
+
+/* How many times a demo has been launched */
+extern int state_launches(const char *demo);
+extern void state_count_launch(const char *demo);
+
+/* Return the SDL_GetTicks() time the state should be written, or 0 if
+   it hasn't changed
+ */
+extern Uint64 state_due(void);
+
+/* Write the state if it has been quiet long enough */
+extern void state_update(void);
+
+/* Hand the state to a background thread to be written, if it has changed.
+   This returns 0, or -1 if it couldn't be written.
+ */
+extern int state_save(void);
+
+/* Wait for any state being written, then free the state without saving it */
+extern void state_free(void);
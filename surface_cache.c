@@ -0,0 +1,332 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* A persistent cache of decoded images in ~/.loki/loki_demos/cache */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+
+#include "surface_cache.h"
+
+#define CACHE_MAGIC     "LOKICAC"
+#define CACHE_VERSION   2
+
+struct cache_header {
+    char   magic[8];
+    Uint32 version;
+    Uint32 window_format;   /* The window format the image was cached for */
+    Uint32 format;          /* The pixel format of the cached image */
+    Uint32 w, h;
+    Uint32 path_len;        /* The source path follows the header */
+    Uint32 surface_class;   /* How the image is blitted, from surface_prep.h */
+    Uint32 unused;
+    Sint64 mtime;           /* Modification time of the source image */
+    Uint64 size;            /* Size of the source image */
+};
+
+static char cache_dir[PATH_MAX];
+static char cache_root[PATH_MAX];
+static SDL_PixelFormat cache_format;
+static SDL_AtomicInt stored_bytes;     /* Stored since we started */
+static SDL_AtomicInt cache_bytes;      /* Total, once it has been measured */
+static SDL_AtomicInt cache_measured;
+static SDL_AtomicInt trimming;
+
+void surface_cache_init(int rebuild)
+{
+    DIR *dir;
+    struct dirent *entry;
+    char path[PATH_MAX];
+
+    cache_dir[0] = '\0';
+    if ( ! getenv("HOME") || ! getcwd(cache_root, sizeof(cache_root)) ) {
+        return;
+    }
+    snprintf(cache_dir, sizeof(cache_dir), "%s/.loki", getenv("HOME"));
+    mkdir(cache_dir, 0700);
+    strcat(cache_dir, "/loki_demos");
+    mkdir(cache_dir, 0700);
+    strcat(cache_dir, "/cache");
+    mkdir(cache_dir, 0700);
+
+    if ( rebuild ) {
+        dir = opendir(cache_dir);
+        if ( dir ) {
+            while ( (entry=readdir(dir)) != NULL ) {
+                if ( (strcmp(entry->d_name, ".") != 0) &&
+                     (strcmp(entry->d_name, "..") != 0) ) {
+                    snprintf(path, sizeof(path), "%s/%s",
+                             cache_dir, entry->d_name);
+                    unlink(path);
+                }
+            }
+            closedir(dir);
+        }
+    }
+}
+
+void surface_cache_format(SDL_PixelFormat format)
+{
+    if ( cache_dir[0] ) {
+        cache_format = format;
+    }
+}
+
+/* Find the cache file for an image, and the full path of the image */
+static void get_cache_path(const char *path, char *key, char *file)
+{
+    Uint64 hash;
+    const char *p;
+
+    snprintf(key, PATH_MAX, "%s/%s", cache_root, path);
+
+    /* FNV-1a is plenty for telling a few hundred paths apart */
+    hash = 0xcbf29ce484222325ULL;
+    for ( p=key; *p; ++p ) {
+        hash ^= (Uint8)*p;
+        hash *= 0x100000001b3ULL;
+    }
+    snprintf(file, PATH_MAX, "%s/%016llx", cache_dir,
+             (unsigned long long)hash);
+}
+
+SDL_Surface *surface_cache_load(const char *path, int *kind)
+{
+    struct cache_header header;
+    struct stat sb;
+    char key[PATH_MAX];
+    char file[PATH_MAX];
+    char source[PATH_MAX];
+    SDL_Surface *image;
+    size_t row_bytes;
+    int fd, row, ok;
+
+    if ( ! cache_format || (stat(path, &sb) < 0) ) {
+        return(NULL);
+    }
+    get_cache_path(path, key, file);
+    fd = open(file, O_RDONLY);
+    if ( fd < 0 ) {
+        return(NULL);
+    }
+
+    /* Make sure this is the same version of the same image */
+    image = NULL;
+    if ( (read(fd, &header, sizeof(header)) != sizeof(header)) ||
+         (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) ||
+         (header.version != CACHE_VERSION) ||
+         (header.window_format != cache_format) ||
+         (header.mtime != sb.st_mtime) || (header.size != sb.st_size) ||
+         (header.path_len != strlen(key)) ||
+         (read(fd, source, header.path_len) != header.path_len) ||
+         (memcmp(source, key, header.path_len) != 0) ) {
+        close(fd);
+        return(NULL);
+    }
+
+    image = SDL_CreateSurface(header.w, header.h,
+                              (SDL_PixelFormat)header.format);
+    if ( ! image ) {
+        close(fd);
+        return(NULL);
+    }
+    row_bytes = (size_t)header.w * SDL_BYTESPERPIXEL(image->format);
+    if ( image->pitch == row_bytes ) {
+        ok = (read(fd, image->pixels, row_bytes*header.h) ==
+                                            row_bytes*header.h);
+    } else {
+        ok = 1;
+        for ( row=0; ok && (row<header.h); ++row ) {
+            ok = (read(fd, (Uint8 *)image->pixels + row*image->pitch,
+                       row_bytes) == row_bytes);
+        }
+    }
+    if ( ok ) {
+        /* Mark the image as recently used */
+        futimens(fd, NULL);
+        *kind = header.surface_class;
+    } else {
+        SDL_DestroySurface(image);
+        image = NULL;
+    }
+    close(fd);
+    return(image);
+}
+
+void surface_cache_store(const char *path, SDL_Surface *image, int kind)
+{
+    struct cache_header header;
+    struct stat sb;
+    char key[PATH_MAX];
+    char file[PATH_MAX];
+    char temp[PATH_MAX];
+    size_t row_bytes;
+    int fd, row, ok, stored;
+
+    if ( ! cache_format || (stat(path, &sb) < 0) ) {
+        return;
+    }
+    get_cache_path(path, key, file);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.window_format = cache_format;
+    header.format = image->format;
+    header.w = image->w;
+    header.h = image->h;
+    header.path_len = strlen(key);
+    header.surface_class = kind;
+    header.mtime = sb.st_mtime;
+    header.size = sb.st_size;
+
+    /* Write to a temporary file so readers never see a partial image */
+    snprintf(temp, sizeof(temp), "%s/.tmpXXXXXX", cache_dir);
+    fd = mkstemp(temp);
+    if ( fd < 0 ) {
+        return;
+    }
+    row_bytes = (size_t)image->w * SDL_BYTESPERPIXEL(image->format);
+    ok = (write(fd, &header, sizeof(header)) == sizeof(header)) &&
+         (write(fd, key, header.path_len) == header.path_len);
+    /* Locking undoes any RLE encoding */
+    SDL_LockSurface(image);
+    for ( row=0; ok && (row<image->h); ++row ) {
+        ok = (write(fd, (Uint8 *)image->pixels + row*image->pitch,
+                    row_bytes) == row_bytes);
+    }
+    SDL_UnlockSurface(image);
+    if ( close(fd) < 0 ) {
+        ok = 0;
+    }
+    if ( ok && (rename(temp, file) == 0) ) {
+        stored = (int)(sizeof(header) + header.path_len +
+                       row_bytes*image->h);
+        SDL_AddAtomicInt(&stored_bytes, stored);
+        SDL_AddAtomicInt(&cache_bytes, stored);
+
+        /* Keep the cache in bounds during long sessions too */
+        surface_cache_trim();
+    } else {
+        unlink(temp);
+    }
+}
+
+struct cache_file {
+    char name[32];
+    off_t size;
+    time_t used;
+};
+
+static int compare_used(const void *a, const void *b)
+{
+    const struct cache_file *A = (const struct cache_file *)a;
+    const struct cache_file *B = (const struct cache_file *)b;
+
+    if ( A->used < B->used ) {
+        return(-1);
+    }
+    return(A->used > B->used);
+}
+
+void surface_cache_trim(void)
+{
+    DIR *dir;
+    struct dirent *entry;
+    struct stat sb;
+    struct cache_file *files;
+    int num_files, max_files, i;
+    Uint64 total;
+    char path[PATH_MAX];
+
+    /* Nothing was added, so the cache can't have grown */
+    if ( SDL_GetAtomicInt(&stored_bytes) == 0 ) {
+        return;
+    }
+    /* The size of the cache is known, and it still fits */
+    if ( SDL_GetAtomicInt(&cache_measured) &&
+         (SDL_GetAtomicInt(&cache_bytes) <= CACHE_MAX_SIZE) ) {
+        return;
+    }
+    /* Another thread is already taking care of it */
+    if ( ! SDL_CompareAndSwapAtomicInt(&trimming, 0, 1) ) {
+        return;
+    }
+
+    dir = opendir(cache_dir);
+    if ( ! dir ) {
+        SDL_SetAtomicInt(&trimming, 0);
+        return;
+    }
+    files = NULL;
+    num_files = max_files = 0;
+    total = 0;
+    while ( (entry=readdir(dir)) != NULL ) {
+        if ( (entry->d_name[0] == '.') ||
+             (strlen(entry->d_name) >= sizeof(files->name)) ) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", cache_dir, entry->d_name);
+        if ( stat(path, &sb) < 0 ) {
+            continue;
+        }
+        if ( num_files == max_files ) {
+            struct cache_file *more;
+
+            max_files += 256;
+            more = (struct cache_file *)realloc(files,
+                                            max_files*(sizeof *files));
+            if ( ! more ) {
+                break;
+            }
+            files = more;
+        }
+        strcpy(files[num_files].name, entry->d_name);
+        files[num_files].size = sb.st_size;
+        files[num_files].used = sb.st_mtime;
+        total += sb.st_size;
+        ++num_files;
+    }
+    closedir(dir);
+
+    /* Throw away the least recently used images until we fit */
+    if ( total > CACHE_MAX_SIZE ) {
+        qsort(files, num_files, sizeof(*files), compare_used);
+        for ( i=0; (i<num_files) && (total>CACHE_MAX_SIZE); ++i ) {
+            snprintf(path, sizeof(path), "%s/%s", cache_dir, files[i].name);
+            if ( unlink(path) == 0 ) {
+                total -= files[i].size;
+            }
+        }
+    }
+    free(files);
+
+    /* Images stored while we were scanning are counted next time */
+    SDL_SetAtomicInt(&cache_bytes, (int)total);
+    SDL_SetAtomicInt(&cache_measured, 1);
+    SDL_SetAtomicInt(&trimming, 0);
+}
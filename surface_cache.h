@@ -0,0 +1,58 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* A persistent cache of decoded images in ~/.loki/loki_demos/cache
+
+   Each cached image is keyed by the full path, size and modification time
+   of the source image, and holds the pixels already prepared for the
+   window by surface_prep(), along with the class of the image.  The
+   cache is measured the first time an image is stored, and whenever it
+   grows past CACHE_MAX_SIZE the least recently used images are removed.
+ */
+
+#include <SDL3/SDL.h>
+
+#define CACHE_MAX_SIZE  (64*1024*1024)
+
+/* Set up the cache directory, emptying it first if rebuild is set */
+extern void surface_cache_init(int rebuild);
+
+/* Set the window format, the cache isn't used until this is called */
+extern void surface_cache_format(SDL_PixelFormat format);
+
+/* Load an image from the cache, and set kind to its class from
+   surface_prep.h.  This returns NULL if the image isn't cached or the
+   source image has changed.
+   This function may be called from any thread.
+ */
+extern SDL_Surface *surface_cache_load(const char *path, int *kind);
+
+/* Save an image that was just decoded and prepared by surface_prep() in
+   the cache, along with its class.
+   This function may be called from any thread.
+ */
+extern void surface_cache_store(const char *path, SDL_Surface *image,
+                                int kind);
+
+/* Remove the least recently used images until the cache fits its size.
+   This does nothing if no images were stored, or the cache is known to fit.
+   This function may be called from any thread.
+ */
+extern void surface_cache_trim(void);
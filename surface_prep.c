@@ -0,0 +1,133 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Getting loaded artwork ready to be blitted onto the window */
+
+#include <SDL3/SDL.h>
+#include "surface_prep.h"
+
+/* The share of pixels that have to be fully opaque or fully transparent,
+   and the share that have to be transparent, for RLE to be worth it
+ */
+#define SPARSE_SOLID_PERCENT        90
+#define SPARSE_TRANSPARENT_PERCENT  25
+
+static SDL_PixelFormat prep_format;
+
+int surface_classify(SDL_Surface *image)
+{
+    SDL_Surface *argb;
+    Uint32 *row;
+    Uint64 total, opaque, transparent;
+    Uint8 alpha;
+    int x, y;
+
+    if ( ! SDL_ISPIXELFORMAT_ALPHA(image->format) &&
+         ! SDL_SurfaceHasColorKey(image) ) {
+        return(SURFACE_OPAQUE);
+    }
+
+    /* Look at the alpha of every pixel, whatever the format */
+    if ( image->format == SDL_PIXELFORMAT_ARGB8888 ) {
+        argb = image;
+    } else {
+        argb = SDL_ConvertSurface(image, SDL_PIXELFORMAT_ARGB8888);
+        if ( ! argb ) {
+            return(SURFACE_BLENDED);
+        }
+    }
+    opaque = 0;
+    transparent = 0;
+    SDL_LockSurface(argb);
+    for ( y=0; y<argb->h; ++y ) {
+        row = (Uint32 *)((Uint8 *)argb->pixels + y*argb->pitch);
+        for ( x=0; x<argb->w; ++x ) {
+            alpha = (Uint8)(row[x] >> 24);
+            if ( alpha == 0xFF ) {
+                ++opaque;
+            } else if ( alpha == 0 ) {
+                ++transparent;
+            }
+        }
+    }
+    SDL_UnlockSurface(argb);
+    if ( argb != image ) {
+        SDL_DestroySurface(argb);
+    }
+
+    total = (Uint64)image->w * image->h;
+    if ( opaque == total ) {
+        return(SURFACE_OPAQUE);
+    }
+    if ( ((opaque + transparent)*100 >= total*SPARSE_SOLID_PERCENT) &&
+         (transparent*100 >= total*SPARSE_TRANSPARENT_PERCENT) ) {
+        return(SURFACE_SPARSE);
+    }
+    return(SURFACE_BLENDED);
+}
+
+void surface_prep_format(SDL_PixelFormat format)
+{
+    prep_format = format;
+}
+
+SDL_Surface *surface_prep(SDL_Surface *image, int *kind)
+{
+    SDL_Surface *converted;
+    SDL_PixelFormat format;
+    int image_class;
+
+    image_class = surface_classify(image);
+    if ( kind ) {
+        *kind = image_class;
+    }
+    if ( ! prep_format ) {
+        return(image);
+    }
+    if ( image_class == SURFACE_OPAQUE ) {
+        format = prep_format;
+    } else {
+        format = SDL_PIXELFORMAT_ARGB8888;
+    }
+    if ( image->format != format ) {
+        converted = SDL_ConvertSurface(image, format);
+        if ( ! converted ) {
+            return(image);
+        }
+        SDL_DestroySurface(image);
+        image = converted;
+    }
+    surface_prep_known(image, image_class);
+    return(image);
+}
+
+void surface_prep_known(SDL_Surface *image, int kind)
+{
+    switch (kind) {
+        case SURFACE_OPAQUE:
+            /* An alpha channel that is all opaque is dropped above */
+            SDL_SetSurfaceColorKey(image, false, 0);
+            SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);
+            break;
+        case SURFACE_SPARSE:
+            SDL_SetSurfaceRLE(image, true);
+            break;
+    }
+}
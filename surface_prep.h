@@ -0,0 +1,57 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Getting loaded artwork ready to be blitted onto the window
+
+   Images are sorted into three classes by looking at their alpha channel:
+   opaque images are converted to the window format so they are copied,
+   images with translucent parts are converted to ARGB8888 to be blended,
+   and images that are mostly either fully transparent or fully opaque
+   are also run length encoded, so the transparent parts are skipped.
+ */
+
+#include <SDL3/SDL.h>
+
+enum {
+    SURFACE_OPAQUE,
+    SURFACE_BLENDED,
+    SURFACE_SPARSE,
+    NUM_SURFACE_CLASSES
+};
+
+/* Find out which class an image belongs to */
+extern int surface_classify(SDL_Surface *image);
+
+/* Set the window format, images aren't converted until this is called */
+extern void surface_prep_format(SDL_PixelFormat format);
+
+/* Convert an image for the window and set it up for the fastest blits.
+   This returns the prepared image and frees the original, or returns the
+   original image if it couldn't be converted.  If kind isn't NULL, it is
+   set to the class of the image.
+   This function may be called from any thread.
+ */
+extern SDL_Surface *surface_prep(SDL_Surface *image, int *kind);
+
+/* Set up an image that was prepared before, from the artwork archive or
+   the cache, for the blits of its class.  The pixels aren't looked at.
+   This function may be called from any thread.
+ */
+extern void surface_prep_known(SDL_Surface *image, int kind);
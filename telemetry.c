@@ -0,0 +1,277 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* A log of every demo launch */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+
+#include <SDL3/SDL.h>
+#include "telemetry.h"
+
+/* The measurements reported by --stats */
+static struct {
+    const char *name;
+    const char *units;
+} metrics[] = {
+    { "exec",     "ms" },
+    { "wall",     "s"  },
+    { "user",     "s"  },
+    { "sys",      "s"  },
+    { "maxrss",   "MB" },
+    { "majflt",   "faults" },
+    { "inblock",  "MB" },
+    { "oublock",  "MB" }
+};
+
+static double get_metric(const struct telemetry_record *record, int metric)
+{
+    switch (metric) {
+        case 0:
+            return(record->exec_ns / 1000000.0);
+        case 1:
+            return(record->wall_ns / 1000000000.0);
+        case 2:
+            return(record->user_us / 1000000.0);
+        case 3:
+            return(record->sys_us / 1000000.0);
+        case 4:
+            return(record->maxrss_kb / 1024.0);
+        case 5:
+            return((double)record->majflt);
+        case 6:
+            return(record->inblock / 2048.0);
+        case 7:
+            return(record->oublock / 2048.0);
+    }
+    return(0.0);
+}
+
+static void get_log_path(char *path, int maxlen)
+{
+    snprintf(path, maxlen, "%s/.loki/loki_demos/%s",
+             getenv("HOME"), TELEMETRY_FILE);
+}
+
+int telemetry_log(const char *demo, Uint64 exec_ns, Uint64 wall_ns,
+                  int status, const struct rusage *usage)
+{
+    char path[PATH_MAX];
+    struct telemetry_header header;
+    struct telemetry_record record;
+    struct stat sb;
+    int fd, result;
+
+    memset(&record, 0, sizeof(record));
+    strncpy(record.demo, demo, sizeof(record.demo)-1);
+    record.time = time(NULL);
+    record.exec_ns = exec_ns;
+    record.wall_ns = wall_ns;
+    record.status = status;
+    if ( usage ) {
+        record.user_us = (Uint64)usage->ru_utime.tv_sec * 1000000 +
+                         usage->ru_utime.tv_usec;
+        record.sys_us = (Uint64)usage->ru_stime.tv_sec * 1000000 +
+                        usage->ru_stime.tv_usec;
+        record.maxrss_kb = usage->ru_maxrss;
+        record.majflt = usage->ru_majflt;
+        record.inblock = usage->ru_inblock;
+        record.oublock = usage->ru_oublock;
+    }
+
+    sprintf(path, "%s/.loki", getenv("HOME"));
+    mkdir(path, 0700);
+    strcat(path, "/loki_demos");
+    mkdir(path, 0700);
+    get_log_path(path, sizeof(path));
+    fd = open(path, O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC, 0600);
+    if ( fd < 0 ) {
+        return(-1);
+    }
+
+    /* Each record goes out in a single write, and the lock keeps other
+       launchers from appending while we check the end of the log.
+     */
+    flock(fd, LOCK_EX);
+    result = 0;
+    if ( fstat(fd, &sb) < 0 ) {
+        result = -1;
+    } else if ( sb.st_size < sizeof(header) ) {
+        /* A new log, or one that crashed writing the header */
+        if ( sb.st_size > 0 ) {
+            result = ftruncate(fd, 0);
+        }
+        sb.st_size = 0;
+    } else if ( (sb.st_size - sizeof(header)) % sizeof(record) ) {
+        /* Drop a partial record, or every record after it is misaligned */
+        result = ftruncate(fd, sb.st_size -
+                               (sb.st_size - sizeof(header)) % sizeof(record));
+    }
+    if ( (result == 0) && (sb.st_size == 0) ) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+        header.version = TELEMETRY_VERSION;
+        header.record_size = sizeof(record);
+        if ( write(fd, &header, sizeof(header)) != sizeof(header) ) {
+            result = -1;
+        }
+    }
+    if ( (result == 0) &&
+         (write(fd, &record, sizeof(record)) != sizeof(record)) ) {
+        result = -1;
+    }
+    close(fd);
+    return(result);
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    const struct telemetry_record *A = (const struct telemetry_record *)a;
+    const struct telemetry_record *B = (const struct telemetry_record *)b;
+    int result;
+
+    result = strcmp(A->demo, B->demo);
+    if ( result == 0 ) {
+        result = (A->time > B->time) - (A->time < B->time);
+    }
+    return(result);
+}
+
+static int compare_values(const void *a, const void *b)
+{
+    double A = *(const double *)a;
+    double B = *(const double *)b;
+
+    return((A > B) - (A < B));
+}
+
+/* Nearest rank percentile of sorted values */
+static double percentile(const double *values, int count, int percent)
+{
+    int rank;
+
+    rank = (count * percent + 99) / 100;
+    if ( rank < 1 ) {
+        rank = 1;
+    }
+    return(values[rank-1]);
+}
+
+static void print_stats(const struct telemetry_record *records, int count,
+                        double *values)
+{
+    char last[32];
+    time_t when;
+    int i, metric, failed;
+
+    failed = 0;
+    for ( i=0; i<count; ++i ) {
+        if ( (records[i].status == -1) || ! WIFEXITED(records[i].status) ||
+             (WEXITSTATUS(records[i].status) != 0) ) {
+            ++failed;
+        }
+    }
+    when = (time_t)records[count-1].time;
+    strftime(last, sizeof(last), "%Y-%m-%d %H:%M", localtime(&when));
+    printf("%s: %d launches, %d failed, last %s\n",
+           records[0].demo, count, failed, last);
+    printf("    %-8s %10s %10s %10s %10s\n", "", "p50", "p90", "p99", "max");
+    for ( metric=0; metric<SDL_arraysize(metrics); ++metric ) {
+        for ( i=0; i<count; ++i ) {
+            values[i] = get_metric(&records[i], metric);
+        }
+        qsort(values, count, sizeof(*values), compare_values);
+        printf("    %-8s %10.2f %10.2f %10.2f %10.2f %s\n",
+               metrics[metric].name,
+               percentile(values, count, 50),
+               percentile(values, count, 90),
+               percentile(values, count, 99),
+               values[count-1], metrics[metric].units);
+    }
+}
+
+int telemetry_stats(const char *demo)
+{
+    char path[PATH_MAX];
+    struct telemetry_header header;
+    struct telemetry_record *records;
+    struct stat sb;
+    double *values;
+    FILE *fp;
+    int i, first, count;
+
+    get_log_path(path, sizeof(path));
+    fp = fopen(path, "rb");
+    if ( ! fp ) {
+        fprintf(stderr, "No launches have been logged in %s\n", path);
+        return(-1);
+    }
+    if ( (fread(&header, sizeof(header), 1, fp) != 1) ||
+         (memcmp(header.magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC)) != 0) ||
+         (header.version != TELEMETRY_VERSION) ||
+         (header.record_size != sizeof(*records)) ||
+         (fstat(fileno(fp), &sb) < 0) ) {
+        fprintf(stderr, "%s is not a launch log this version can read\n", path);
+        fclose(fp);
+        return(-1);
+    }
+
+    /* A partial record at the end is left over from a crash, skip it */
+    count = (sb.st_size - sizeof(header)) / sizeof(*records);
+    records = (struct telemetry_record *)malloc((count+1)*(sizeof *records));
+    values = (double *)malloc((count+1)*(sizeof *values));
+    if ( ! records || ! values ) {
+        fprintf(stderr, "Out of memory\n");
+        free(records);
+        free(values);
+        fclose(fp);
+        return(-1);
+    }
+    count = fread(records, sizeof(*records), count, fp);
+    fclose(fp);
+    for ( i=0; i<count; ++i ) {
+        records[i].demo[sizeof(records[i].demo)-1] = '\0';
+    }
+
+    /* Group the launches of each demo together, oldest first */
+    qsort(records, count, sizeof(*records), compare_records);
+    for ( first=0; first<count; first=i ) {
+        for ( i=first+1; i<count; ++i ) {
+            if ( strcmp(records[i].demo, records[first].demo) != 0 ) {
+                break;
+            }
+        }
+        if ( ! demo || (strcasecmp(demo, records[first].demo) == 0) ) {
+            print_stats(&records[first], i-first, values);
+        }
+    }
+    free(records);
+    free(values);
+    return(0);
+}
@@ -0,0 +1,72 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* A log of every demo launch, for spotting regressions after updates
+
+   Each launch appends one fixed size record to
+   ~/.loki/loki_demos/launches.log, after a header written when the log
+   is created.  Records are stored in native byte order, and are never
+   rewritten.  A partial record left at the end by a crash is cut off
+   before the next record is appended, so the records stay aligned.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <SDL3/SDL.h>
+
+#define TELEMETRY_FILE      "launches.log"
+#define TELEMETRY_MAGIC     "LOKILOG"
+#define TELEMETRY_VERSION   1
+
+struct telemetry_header {
+    char   magic[8];
+    Uint32 version;
+    Uint32 record_size;
+};
+
+struct telemetry_record {
+    char   demo[64];
+    Sint64 time;            /* When the demo was launched, in seconds */
+    Uint64 exec_ns;         /* From the click to the demo being started */
+    Uint64 wall_ns;         /* From being started to exiting */
+    Uint64 user_us;         /* CPU time */
+    Uint64 sys_us;
+    Uint64 maxrss_kb;       /* Peak resident set size */
+    Uint64 majflt;          /* Page faults that needed I/O */
+    Uint64 inblock;         /* Block I/O, in 512 byte blocks */
+    Uint64 oublock;
+    Sint32 status;          /* The wait status, -1 if it couldn't be run */
+    Uint32 unused;
+};
+
+/* Append the record of a launch to the log.
+   The usage may be NULL if it isn't known.
+   This returns 0, or -1 if the log couldn't be written.
+ */
+extern int telemetry_log(const char *demo, Uint64 exec_ns, Uint64 wall_ns,
+                         int status, const struct rusage *usage);
+
+/* Print percentiles of the logged launches of each demo, or just the
+   given one if it isn't NULL.
+   This returns 0, or -1 if there is no usable log.
+ */
+extern int telemetry_stats(const char *demo);
@@ -0,0 +1,156 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Timed spans written out in the Chrome trace event format */
+
+#include <sys/syscall.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <SDL3/SDL.h>
+#include "trace.h"
+
+#define MAX_EVENTS  16384
+
+struct trace_event {
+    char phase;
+    const char *name;
+    char arg[64];
+    long tid;
+    Uint64 ns;
+};
+
+int trace_enabled = 0;
+
+static FILE *trace_fp;
+static struct trace_event *events;
+static SDL_AtomicInt num_events;
+
+static Uint64 trace_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return((Uint64)now.tv_sec * 1000000000 + now.tv_nsec);
+}
+
+int trace_open(const char *file)
+{
+    if ( trace_enabled ) {
+        return(0);
+    }
+
+    /* Open the file now, since we change directories at startup */
+    trace_fp = fopen(file, "w");
+    if ( ! trace_fp ) {
+        perror(file);
+        return(-1);
+    }
+    events = (struct trace_event *)malloc(MAX_EVENTS*(sizeof *events));
+    if ( ! events ) {
+        fclose(trace_fp);
+        trace_fp = NULL;
+        return(-1);
+    }
+    SDL_SetAtomicInt(&num_events, 0);
+    trace_enabled = 1;
+    atexit(trace_close);
+    return(0);
+}
+
+void trace_event(char phase, const char *name, const char *arg)
+{
+    struct trace_event *event;
+    int slot;
+
+    slot = SDL_AddAtomicInt(&num_events, 1);
+    if ( slot >= MAX_EVENTS ) {
+        return;
+    }
+    event = &events[slot];
+    event->phase = phase;
+    event->name = name;
+    if ( arg ) {
+        strncpy(event->arg, arg, sizeof(event->arg)-1);
+        event->arg[sizeof(event->arg)-1] = '\0';
+    } else {
+        event->arg[0] = '\0';
+    }
+    event->tid = syscall(SYS_gettid);
+    event->ns = trace_now();
+}
+
+static void write_string(const char *str)
+{
+    fputc('"', trace_fp);
+    for ( ; *str; ++str ) {
+        if ( (*str == '"') || (*str == '\\') ) {
+            fprintf(trace_fp, "\\%c", *str);
+        } else if ( (unsigned char)*str < ' ' ) {
+            fprintf(trace_fp, "\\u%04x", (unsigned char)*str);
+        } else {
+            fputc(*str, trace_fp);
+        }
+    }
+    fputc('"', trace_fp);
+}
+
+void trace_close(void)
+{
+    int i, count;
+    struct trace_event *event;
+
+    if ( ! trace_enabled ) {
+        return;
+    }
+    trace_enabled = 0;
+
+    count = SDL_GetAtomicInt(&num_events);
+    if ( count > MAX_EVENTS ) {
+        fprintf(stderr, "Warning: trace truncated to %d events\n", MAX_EVENTS);
+        count = MAX_EVENTS;
+    }
+    fprintf(trace_fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for ( i=0; i<count; ++i ) {
+        event = &events[i];
+        fprintf(trace_fp, "{\"name\":");
+        write_string(event->name);
+        fprintf(trace_fp,
+                ",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%ld",
+                event->phase,
+                (unsigned long long)(event->ns / 1000),
+                (unsigned int)(event->ns % 1000),
+                (int)getpid(), event->tid);
+        if ( event->arg[0] ) {
+            fprintf(trace_fp, ",\"args\":{\"name\":");
+            write_string(event->arg);
+            fputc('}', trace_fp);
+        }
+        fprintf(trace_fp, "}%s\n", (i < count-1) ? "," : "");
+    }
+    fprintf(trace_fp, "]}\n");
+    fclose(trace_fp);
+    trace_fp = NULL;
+    free(events);
+    events = NULL;
+}
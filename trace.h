@@ -0,0 +1,47 @@
+/*
+    Loki_Demos - A demo launching UI for games distributed by Loki
+    Copyright (C) 2000  Loki Software, Inc.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+    info@lokigames.com
+*/
+
+/* Timed spans written out in the Chrome trace event format, which can be
+   loaded into chrome://tracing or https://ui.perfetto.dev
+
+   When tracing isn't turned on, TRACE_BEGIN() and TRACE_END() only cost
+   a test of trace_enabled.
+ */
+
+extern int trace_enabled;
+
+#define TRACE_BEGIN(name, arg) \
+    do { if ( trace_enabled ) trace_event('B', name, arg); } while ( 0 )
+#define TRACE_END(name) \
+    do { if ( trace_enabled ) trace_event('E', name, NULL); } while ( 0 )
+
+/* Start tracing, the trace will be written to the given file at exit.
+   This returns 0, or -1 if the file couldn't be created.
+ */
+extern int trace_open(const char *file);
+
+/* Record the start ('B') or end ('E') of a span on the current thread.
+   The name must be a string constant, the optional argument is copied.
+   This function may be called from any thread.
+ */
+extern void trace_event(char phase, const char *name, const char *arg);
+
+/* Write out the trace and stop tracing */
+extern void trace_close(void);